@@ -0,0 +1,101 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (fd >= 0)
+		close(fd);
+#endif
+}
+
+bool FileWatcher::Watch(const std::string& path)
+{
+	for (const File& file : files)
+		if (file.path == path)
+			return true;
+
+	File file;
+	file.path = path;
+	std::filesystem::path p(path);
+	file.directory = p.has_parent_path() ? p.parent_path() : std::filesystem::path(".");
+	file.name = p.filename();
+	std::error_code ec;
+	file.written = std::filesystem::last_write_time(p, ec);
+
+#ifdef __linux__
+	if (fd < 0)
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (std::find(directories.begin(), directories.end(), file.directory) == directories.end())
+	{
+		int wd = inotify_add_watch(fd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0)
+			return false;
+		watches.push_back(wd);
+		directories.push_back(file.directory);
+	}
+#endif
+
+	files.push_back(std::move(file));
+	return true;
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+	std::vector<std::string> changed;
+	auto report = [&changed](const std::string& path) {
+		if (std::find(changed.begin(), changed.end(), path) == changed.end())
+			changed.push_back(path);
+	};
+
+#ifdef __linux__
+	if (fd < 0)
+		return changed;
+
+	// Events are variable length, the buffer is aligned for the header
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(fd, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+		for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+		{
+			const inotify_event* event = (const inotify_event*)p;
+			if (event->len == 0)
+				continue;
+			size_t directory = std::find(watches.begin(), watches.end(), event->wd) - watches.begin();
+			if (directory == watches.size())
+				continue;
+			for (const File& file : files)
+				if (file.directory == directories[directory] && file.name == event->name)
+					report(file.path);
+		}
+	}
+#else
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastPoll < PollInterval)
+		return changed;
+	lastPoll = now;
+
+	for (File& file : files)
+	{
+		std::error_code ec;
+		std::filesystem::file_time_type written = std::filesystem::last_write_time(file.path, ec);
+		if (!ec && written != file.written)
+		{
+			file.written = written;
+			report(file.path);
+		}
+	}
+#endif
+	return changed;
+}
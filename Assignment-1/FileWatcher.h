@@ -0,0 +1,49 @@
+#ifndef FILE_WATCHER_CLASS_H
+#define FILE_WATCHER_CLASS_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Reports watched files that were written since the last Poll, without ever blocking.
+// On Linux it is an inotify watch on each file's directory, so editors that save through
+// a temporary file and a rename are seen too. Elsewhere Poll compares last write times,
+// at most every PollInterval.
+class FileWatcher
+{
+public:
+	static constexpr std::chrono::milliseconds PollInterval{ 250 };
+
+	FileWatcher() = default;
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Adding a path twice is harmless, returns false if it can't be watched
+	bool Watch(const std::string& path);
+
+	// Paths as given to Watch, each at most once per call
+	std::vector<std::string> Poll();
+
+private:
+	struct File
+	{
+		std::string path;
+		std::filesystem::path directory;
+		std::filesystem::path name;
+		std::filesystem::file_time_type written;
+	};
+	std::vector<File> files;
+
+#ifdef __linux__
+	int fd = -1;
+	// Watch descriptor of each directory, in step with directories
+	std::vector<int> watches;
+	std::vector<std::filesystem::path> directories;
+#else
+	std::chrono::steady_clock::time_point lastPoll;
+#endif
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef GL_HANDLE_CLASS_H
+#define GL_HANDLE_CLASS_H
+
+#include <glad/glad.h>
+
+// Owning wrapper around a GL object name. Move-only, so the object is deleted exactly
+// once by whichever handle holds it last. Destroy handles while the context is current.
+template <void (*Delete)(GLuint)>
+class GLHandle
+{
+public:
+	GLHandle() = default;
+	explicit GLHandle(GLuint id) : id(id) {}
+	~GLHandle() { reset(); }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+	GLHandle(GLHandle&& other) noexcept : id(other.release()) {}
+	GLHandle& operator=(GLHandle&& other) noexcept
+	{
+		if (this != &other)
+			reset(other.release());
+		return *this;
+	}
+
+	GLuint get() const { return id; }
+	explicit operator bool() const { return id != 0; }
+
+	// Gives up ownership without deleting
+	GLuint release()
+	{
+		GLuint name = id;
+		id = 0;
+		return name;
+	}
+
+	void reset(GLuint name = 0)
+	{
+		if (id)
+			Delete(id);
+		id = name;
+	}
+
+private:
+	GLuint id = 0;
+};
+
+namespace gl
+{
+	inline void DeleteBuffer(GLuint id) { glDeleteBuffers(1, &id); }
+	inline void DeleteVertexArray(GLuint id) { glDeleteVertexArrays(1, &id); }
+}
+
+using BufferHandle = GLHandle<gl::DeleteBuffer>;
+using VertexArrayHandle = GLHandle<gl::DeleteVertexArray>;
+
+inline BufferHandle GenBuffer()
+{
+	GLuint id;
+	glGenBuffers(1, &id);
+	return BufferHandle(id);
+}
+
+inline VertexArrayHandle GenVertexArray()
+{
+	GLuint id;
+	glGenVertexArrays(1, &id);
+	return VertexArrayHandle(id);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+
+void InstanceBuffer::Create(size_t initialCapacity)
+{
+	capacity = std::max<size_t>(initialCapacity, 1);
+	count = 0;
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Upload(const InstanceData* instances, size_t instanceCount)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	if (instanceCount > capacity)
+		capacity = std::max(instanceCount, capacity * 2);
+	// Orphan the old storage so the upload does not wait on draws still reading it
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(InstanceData), instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	count = instanceCount;
+}
+
+void InstanceBuffer::Delete()
+{
+	glDeleteBuffers(1, &ID);
+	ID = 0;
+	capacity = count = 0;
+}
+
+void InstanceBuffer::SetAttributes()
+{
+	// mat4 as four vec4 columns
+	for (GLuint column = 0; column < 4; column++)
+	{
+		GLuint location = FirstLocation + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+			(void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+	}
+
+	GLuint material = FirstLocation + 4;
+	glEnableVertexAttribArray(material);
+	glVertexAttribIPointer(material, 1, GL_UNSIGNED_INT, sizeof(InstanceData), (void*)offsetof(InstanceData, material));
+	glVertexAttribDivisor(material, 1);
+}
+
+void InstanceBuffer::DisableAttributes()
+{
+	for (GLuint location = FirstLocation; location < FirstLocation + 5; location++)
+		glDisableVertexAttribArray(location);
+}
@@ -0,0 +1,42 @@
+#ifndef INSTANCE_BUFFER_CLASS_H
+#define INSTANCE_BUFFER_CLASS_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-instance vertex data read by the INSTANCED variant of default.vert
+struct InstanceData
+{
+	glm::mat4 model;
+	unsigned int material;  // index into the MaterialData block, below MaxMaterials
+};
+
+// Vertex buffer of InstanceData with a divisor of 1. Meshes point their VAO at it once
+// (Mesh::SetInstanceBuffer), afterwards Upload only replaces the contents: growing keeps
+// the buffer name, so the VAOs stay valid.
+class InstanceBuffer
+{
+public:
+	// First attribute location used, the matrix takes four
+	static constexpr GLuint FirstLocation = 3;
+
+	GLuint ID = 0;
+
+	void Create(size_t capacity = 1);
+	void Upload(const InstanceData* instances, size_t count);
+	void Delete();
+
+	size_t Count() const { return count; }
+
+	// Attribute pointers 3-7 for the buffer bound to GL_ARRAY_BUFFER, into the bound VAO
+	static void SetAttributes();
+	static void DisableAttributes();
+
+private:
+	size_t capacity = 0;
+	size_t count = 0;
+};
+
+#endif
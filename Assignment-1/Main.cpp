@@ -1,10 +1,20 @@
 ﻿#include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
 
 #include "shaderClass.h"
 #include "Camera.h"
+#include "InstanceBuffer.h"
 #include "Model.h"
+#include "ProgramCache.h"
+#include "RenderQueue.h"
+#include "ShaderManager.h"
+#include "UniformBuffer.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -13,6 +23,13 @@
 // ------- Window -------
 constexpr unsigned int SCR_WIDTH = 1980;
 constexpr unsigned int SCR_HEIGHT = 1080;
+constexpr unsigned int BENCH_REPORT_FRAMES = 240;
+// Size of the start-up RenderQueue sort benchmark, 0 skips it
+constexpr unsigned int RENDER_QUEUE_BENCH_PACKETS = 50000;
+// Largest copy count of the start-up instancing benchmark, 0 skips it. One draw per copy
+// is only timed up to INSTANCE_BENCH_PER_COPY_MAX.
+constexpr unsigned int INSTANCE_BENCH_MAX = 100000;
+constexpr unsigned int INSTANCE_BENCH_PER_COPY_MAX = 10000;
 
 // ------- Camera -------
 Camera camera(SCR_WIDTH, SCR_HEIGHT, glm::vec3(0.0f, 0.5f, 5.0f));
@@ -23,6 +40,135 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
+// ------- Render Queue Benchmark -------
+// RENDER_QUEUE_BENCH_PACKETS random packets (a tenth of them transparent) submitted and
+// radix sorted the way a frame does it, against std::sort on the same keys
+void benchmarkRenderQueue()
+{
+    if (RENDER_QUEUE_BENCH_PACKETS == 0)
+        return;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> depth(0.1f, 100.0f);
+    std::vector<uint64_t> keys(RENDER_QUEUE_BENCH_PACKETS);
+    for (uint64_t& key : keys)
+    {
+        RenderQueue::Pass pass = rng() % 10 == 0 ? RenderQueue::Transparent : RenderQueue::Opaque;
+        key = RenderQueue::MakeKey(pass, rng() % 8, rng() % 256, depth(rng));
+    }
+
+    const int runs = 20;
+    RenderQueue queue;
+    queue.Reserve(keys.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; run++)
+    {
+        queue.Clear();
+        for (size_t i = 0; i < keys.size(); i++)
+            queue.Submit(keys[i], (uint32_t)i);
+        queue.Sort();
+    }
+    double radixMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+    std::vector<RenderQueue::Packet> reference(keys.size());
+    start = std::chrono::steady_clock::now();
+    for (int run = 0; run < runs; run++)
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+            reference[i] = RenderQueue::Packet{ keys[i], (uint32_t)i };
+        std::sort(reference.begin(), reference.end(),
+            [](const RenderQueue::Packet& a, const RenderQueue::Packet& b) { return a.key < b.key; });
+    }
+    double stdMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+    bool sorted = std::is_sorted(queue.Packets().begin(), queue.Packets().end(),
+        [](const RenderQueue::Packet& a, const RenderQueue::Packet& b) { return a.key < b.key; });
+    std::cout << "[RenderQueue] " << keys.size() << " packets: submit + radix sort " << radixMs << " ms, std::sort "
+        << stdMs << " ms" << (sorted ? "" : " (NOT SORTED)") << "\n";
+}
+
+// ------- Instancing Benchmark -------
+// 1, 10, ... INSTANCE_BENCH_MAX copies of model in a grid: one instanced draw per mesh
+// against one ObjectData update and draw per copy. Copies cycle through three variations of
+// material, picked per instance from MaterialData and per copy through ObjectData.
+// Times include glFinish.
+void benchmarkInstancing(Model& model, Shader& perCopyShader, Shader& instancedShader, const ObjectData& material)
+{
+    if (INSTANCE_BENCH_MAX == 0)
+        return;
+
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    UniformBuffer objectBuffer;
+    objectBuffer.Create(sizeof(ObjectData), ObjectBinding);
+    objectBuffer.Update(&material, sizeof(material));
+    const MaterialParams materials[3] = {
+        { material.ambientStrength, material.specularStrength, material.shininess, material.roughness },
+        { material.ambientStrength, material.specularStrength * 2.0f, material.shininess * 4.0f, material.roughness * 0.5f },
+        { material.ambientStrength * 1.5f, material.specularStrength * 0.25f, material.shininess * 0.25f, 1.0f },
+    };
+    UniformBuffer materialBuffer;
+    materialBuffer.Create(sizeof(MaterialParams) * MaxMaterials, MaterialBinding);
+    materialBuffer.Update(materials, sizeof(materials));
+    InstanceBuffer instances;
+    instances.Create(INSTANCE_BENCH_MAX);
+    std::vector<InstanceData> data;
+
+    for (unsigned int count = 1; count <= INSTANCE_BENCH_MAX; count *= 10)
+    {
+        // Square grid in front of the camera, shrinking as it fills up
+        int side = (int)std::ceil(std::sqrt((double)count));
+        float spacing = 10.0f / side;
+        data.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glm::vec3 position(-5.0f + (i % side + 0.5f) * spacing, -5.0f + (i / side + 0.5f) * spacing, -5.0f);
+            data[i].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.25f * spacing));
+            data[i].material = i % 3;
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        instances.Upload(data.data(), count);
+        instancedShader.Activate();
+        model.DrawInstanced(instancedShader, instances);
+        glFinish();
+        double instancedMs = msSince(start);
+
+        std::cout << "[Instancing] " << count << " copies: instanced " << instancedMs << " ms";
+        if (count <= INSTANCE_BENCH_PER_COPY_MAX)
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glFinish();
+            start = std::chrono::steady_clock::now();
+            perCopyShader.Activate();
+            ObjectData object = material;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const MaterialParams& params = materials[data[i].material];
+                object.model = data[i].model;
+                object.ambientStrength = params.ambientStrength;
+                object.specularStrength = params.specularStrength;
+                object.shininess = params.shininess;
+                object.roughness = params.roughness;
+                objectBuffer.Update(&object, sizeof(object));
+                model.Draw(perCopyShader);
+            }
+            glFinish();
+            std::cout << ", per copy " << msSince(start) << " ms";
+        }
+        std::cout << " (" << model.drawnTriangles << " tris)\n";
+    }
+
+    model.DetachInstanceBuffer();
+    instances.Delete();
+    objectBuffer.Delete();
+    materialBuffer.Delete();
+}
+
 int main()
 {
     // GLFW
@@ -38,6 +184,9 @@ int main()
 
     // GLAD
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    ProgramCache::Shared().Load((GLADloadproc)glfwGetProcAddress);
+    ShaderManager shaders;
+    shaders.Load((GLADloadproc)glfwGetProcAddress);
     glEnable(GL_DEPTH_TEST);
 
     // ImGui init
@@ -48,12 +197,18 @@ int main()
     ImGui_ImplOpenGL3_Init("#version 330");
 
     // Shader
-    Shader phongShader("default.vert", "phong.frag");
-    Shader cookShader("default.vert", "cook_torrance.frag");
-    Shader toonShader("default.vert", "toon.frag");
+    // All builds are submitted here and draw with the fallback until they link,
+    // edits to the sources are rebuilt and swapped in while running
+    shaders.SetFallback("default.vert", "fallback.frag");
+    Shader& phongShader = shaders.Add("default.vert", "phong.frag");
+    Shader& cookShader = shaders.Add("default.vert", "cook_torrance.frag");
+    Shader& toonShader = shaders.Add("default.vert", "toon.frag");
+    // default.vert reading the model matrix from the per-instance attributes
+    Shader& instancedPhongShader = shaders.Add("default.vert", "phong.frag", "#define INSTANCED\n");
 
     // Model
-    Model model("Models/Bottle.glb");
+    // Owns GL objects, reset before the context goes
+    std::unique_ptr<Model> model = std::make_unique<Model>("Models/Bottle.glb");
 
     float ambient = 0.4f;
     float specularStr = 0.5f;
@@ -80,9 +235,36 @@ int main()
     &toonShader
     };
 
+    // Camera and light live in one UBO per frame, per-object data in a ring of records
+    shaders.BindUniformBlock("FrameData", FrameBinding);
+    shaders.BindUniformBlock("ObjectData", ObjectBinding);
+    shaders.BindUniformBlock("MaterialData", MaterialBinding);
+    UniformBuffer frameUniforms;
+    frameUniforms.Create(sizeof(FrameData), FrameBinding);
+    UniformRing objectUniforms;
+    objectUniforms.Create(sizeof(ObjectData), 64, ObjectBinding);
+
+    benchmarkRenderQueue();
+
+    camera.updateMatrix(45.0f, 0.1f, 100.0f);
+    FrameData benchFrame = { camera.cameraMatrix, camera.Position, lightAmbient, lightPos, lightDiffuse, lightColor, lightSpecular };
+    frameUniforms.Update(&benchFrame, sizeof(benchFrame));
+    ObjectData benchMaterial = { glm::mat4(1.0f), ambient, specularStr, shininess, 0.6f };
+    // The benchmark needs the real programs
+    if (INSTANCE_BENCH_MAX != 0)
+        shaders.WaitAll();
+    benchmarkInstancing(*model, phongShader, instancedPhongShader, benchMaterial);
+    RenderQueue queue;
+
+    int frameCount = 0;
+    double drawMs = 0.0;
+    size_t programSwitches = 0;
+    size_t drawnTriangles = 0, culledTriangles = 0;
+
     // Render loop 
     while (!glfwWindowShouldClose(window))
     {
+        shaders.Update();
         camera.Inputs(window);
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -141,33 +323,27 @@ int main()
         ImGui::End();
 
 
-        // Shader
-        phongShader.Activate();
         camera.updateMatrix(45.0f, 0.1f, 100.0f);
-        camera.Matrix(phongShader, "camMatrix");
-
-        phongShader.setVec3("lightPos", lightPos);
-        phongShader.setVec3("lightColor", lightColor);
-        phongShader.setVec3("camPos", camera.Position);
 
         float time = (float)glfwGetTime();
-
+        auto drawStart = std::chrono::steady_clock::now();
+
+        FrameData frame;
+        frame.camMatrix = camera.cameraMatrix;
+        frame.camPos = camera.Position;
+        frame.lightAmbient = lightAmbient;
+        frame.lightPos = lightPos;
+        frame.lightDiffuse = lightDiffuse;
+        frame.lightColor = lightColor;
+        frame.lightSpecular = lightSpecular;
+        frameUniforms.Update(&frame, sizeof(frame));
+
+        // Every object's record goes up in one upload before any draw
+        glm::mat4 modelMats[3];
+        GLintptr objectOffsets[3];
+        objectUniforms.BeginFrame();
         for (int i = 0; i < 3; i++)
         {
-            Shader& shader = *potShaders[i];
-            shader.Activate();
-
-            camera.updateMatrix(45.0f, 0.1f, 100.0f);
-            camera.Matrix(shader, "camMatrix");
-
-            shader.setVec3("lightPos", lightPos);
-            shader.setVec3("lightColor", lightColor);
-            shader.setFloat("lightAmbient", lightAmbient);
-            shader.setFloat("lightDiffuse", lightDiffuse);
-            shader.setFloat("lightSpecular", lightSpecular);
-
-            shader.setVec3("camPos", camera.Position);
-
             glm::mat4 modelMat = baseModel;
             modelMat = glm::translate(modelMat, positions[i]);
             modelMat = glm::rotate(
@@ -175,21 +351,72 @@ int main()
                 time * (0.6f + i * 0.1f),
                 glm::vec3(0.2f, 1, 0.3f)
             );
+            modelMats[i] = modelMat;
+
+            ObjectData object;
+            object.model = modelMat;
+            object.ambientStrength = ambient;
+            object.specularStrength = specularStr;
+            object.shininess = shininess;
+            object.roughness = roughness;
+            objectOffsets[i] = objectUniforms.Push(&object, sizeof(object));
+        }
+        objectUniforms.Flush();
+
+        // Grouped by program, front to back inside each group. The pots share one model,
+        // so there is a single material.
+        // Programs still compiling resolve to the fallback
+        queue.Clear();
+        Shader* drawShaders[3];
+        for (int i = 0; i < 3; i++)
+        {
+            drawShaders[i] = &shaders.Get(*potShaders[i]);
+            float depth = glm::distance(camera.Position, glm::vec3(modelMats[i][3]));
+            queue.Submit(RenderQueue::MakeKey(RenderQueue::Opaque, drawShaders[i]->ID, 0, depth), (uint32_t)i);
+        }
+        queue.Sort();
 
-            shader.setMat4("model", modelMat);
-            if (&shader == &phongShader)
+        const Shader* activeShader = nullptr;
+        for (const RenderQueue::Packet& packet : queue.Packets())
+        {
+            Shader& shader = *drawShaders[packet.item];
+            const glm::mat4& modelMat = modelMats[packet.item];
+            if (&shader != activeShader)
             {
-                shader.setFloat("ambientStrength", ambient);
-                shader.setFloat("specularStrength", specularStr);
-                shader.setFloat("shininess", shininess);
+                shader.Activate();
+                activeShader = &shader;
+                programSwitches++;
             }
-            else if (&shader == &cookShader)
+            objectUniforms.Bind(objectOffsets[packet.item]);
+
+            model->Draw(shader, camera, modelMat);
+            drawnTriangles += model->drawnTriangles;
+            culledTriangles += model->culledTriangles;
+        }
+        objectUniforms.EndFrame();
+        drawMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - drawStart).count();
+
+        if (++frameCount % BENCH_REPORT_FRAMES == 0)
+        {
+            // Builds nothing has drawn with yet may still be compiling, finish them so the
+            // stats cover every start-up program
+            if (frameCount == BENCH_REPORT_FRAMES)
             {
-                shader.setFloat("roughness", roughness); // add a slider
-                shader.setFloat("lightAmbient", lightAmbient);
-                shader.setFloat("lightDiffuse", lightDiffuse);
+                shaders.WaitAll();
+                const ProgramCache::Stats& programs = ProgramCache::Shared().GetStats();
+                std::cout << "[ProgramCache] " << programs.hits << " hits, " << programs.misses << " misses ("
+                    << programs.rejected << " rejected), " << programs.loadMs << " ms loading binaries, "
+                    << programs.compileMs << " ms compiling, " << programs.savedMs << " ms compile time saved\n";
+                std::cout << "[ShaderManager] " << shaders.GetStats().builds << " builds, "
+                    << shaders.GetStats().fallbackUses << " fallback draws, " << shaders.GetStats().failures << " failed\n";
             }
-            model.Draw(shader);
+            std::cout << "[Bench] bottles " << drawMs / BENCH_REPORT_FRAMES << " ms CPU/frame, "
+                << drawnTriangles / BENCH_REPORT_FRAMES << " tris drawn, "
+                << 100.0 * culledTriangles / std::max<size_t>(drawnTriangles + culledTriangles, 1)
+                << "% culled by meshlets, " << (double)programSwitches / BENCH_REPORT_FRAMES << " program switches/frame\n";
+            drawMs = 0.0;
+            programSwitches = 0;
+            drawnTriangles = culledTriangles = 0;
         }
         // ImGui render
         ImGui::Render();
@@ -200,6 +427,10 @@ int main()
     }
 
     // Cleanup
+    model.reset();
+    shaders.Delete();
+    frameUniforms.Delete();
+    objectUniforms.Delete();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -1,4 +1,5 @@
 ﻿#include "Mesh.h"
+#include "MeshletBuilder.h"
 #include <glad/glad.h>
 
 Mesh::Mesh(std::vector<Vertex> verts,
@@ -9,21 +10,22 @@ Mesh::Mesh(std::vector<Vertex> verts,
     indices = std::move(inds);
     textures = std::move(tex);
 
+    meshlets = MeshletBuilder::Build(vertices.data(), indices.data(), indices.size());
     setupMesh();
 }
 
 void Mesh::setupMesh()
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    VAO = GenVertexArray();
+    VBO = GenBuffer();
+    EBO = GenBuffer();
 
-    glBindVertexArray(VAO);
+    glBindVertexArray(VAO.get());
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     // Position
@@ -41,7 +43,7 @@ void Mesh::setupMesh()
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(Shader& shader)
+void Mesh::bindMaterial(Shader& shader)
 {
     unsigned int unit = 0;
 
@@ -52,8 +54,57 @@ void Mesh::Draw(Shader& shader)
         shader.setInt(t.type.c_str(), unit);
         unit++;
     }
+}
+
+void Mesh::Draw(Shader& shader)
+{
+    bindMaterial(shader);
 
-    glBindVertexArray(VAO);
+    glBindVertexArray(VAO.get());
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 }
+
+void Mesh::SetInstanceBuffer(const InstanceBuffer* instances)
+{
+    glBindVertexArray(VAO.get());
+    if (instances)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instances->ID);
+        InstanceBuffer::SetAttributes();
+    }
+    else
+    {
+        InstanceBuffer::DisableAttributes();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::DrawInstanced(Shader& shader, GLsizei instanceCount)
+{
+    if (instanceCount <= 0)
+        return;
+
+    bindMaterial(shader);
+
+    glBindVertexArray(VAO.get());
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, 0, instanceCount);
+    glBindVertexArray(0);
+}
+
+size_t Mesh::DrawCulled(Shader& shader, const glm::mat4& clipFromObject, const glm::vec3& eyeObject)
+{
+    // Reused between calls, drawing only ever happens on the GL thread
+    static std::vector<MeshletBuilder::Span> spans;
+    size_t triangles = MeshletBuilder::Cull(meshlets, MeshletBuilder::ObjectFrustum(clipFromObject, eyeObject), spans);
+    if (spans.empty())
+        return 0;
+
+    bindMaterial(shader);
+    glBindVertexArray(VAO.get());
+    for (const MeshletBuilder::Span& s : spans)
+        glDrawElements(GL_TRIANGLES, s.indexCount, GL_UNSIGNED_INT, (void*)(s.firstIndex * sizeof(unsigned int)));
+    glBindVertexArray(0);
+    return triangles;
+}
@@ -5,7 +5,9 @@
 #include <string>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include "GLHandle.h"
 #include "shaderClass.h"
+#include "InstanceBuffer.h"
 
 struct Vertex {
     glm::vec3 Position;
@@ -13,6 +15,18 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Cluster of up to 64 vertices / 124 consecutive triangles (MeshletBuilder)
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int triangleCount;
+    unsigned int vertexCount;
+    unsigned int pad;
+    glm::vec3 center;     // bounding sphere
+    float radius;
+    glm::vec3 coneAxis;   // average face normal
+    float coneCutoff;     // sine of the cone spread, 1 disables backface rejection
+};
+
 struct TextureInfo {
     unsigned int id;
     std::string type;   // baseColorMap / normalMap / metalRoughMap / emissiveMap
@@ -25,15 +39,33 @@ public:
     std::vector<unsigned int> indices;
     std::vector<TextureInfo> textures;
 
-    unsigned int VAO, VBO, EBO;
+    std::vector<Meshlet> meshlets;
+
+    VertexArrayHandle VAO;
+    BufferHandle VBO, EBO;
 
     Mesh(std::vector<Vertex> verts,
         std::vector<unsigned int> inds,
         std::vector<TextureInfo> tex);
+    // Owns its GL objects, so it can only be moved
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
 
     void Draw(Shader& shader); // no const now
 
+    // Draws the meshlets that pass frustum and cone culling, returns the triangles drawn
+    size_t DrawCulled(Shader& shader, const glm::mat4& clipFromObject, const glm::vec3& eyeObject);
+
+    // Points attributes 3-7 of the VAO at instances, needed once before DrawInstanced.
+    // nullptr disables them again.
+    void SetInstanceBuffer(const InstanceBuffer* instances);
+    // Whole mesh once per instance, for shaders built with INSTANCED. No meshlet culling.
+    void DrawInstanced(Shader& shader, GLsizei instanceCount);
+
 private:
+    void bindMaterial(Shader& shader);
     void setupMesh();
 };
 
@@ -0,0 +1,47 @@
+#ifndef MESHLET_BUILDER_CLASS_H
+#define MESHLET_BUILDER_CLASS_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// Splits triangle lists into small clusters with conservative bounds so whole clusters
+// can be rejected on the CPU before submission. Clusters are runs of consecutive
+// triangles, so the (already cache optimized) index order is kept and visible
+// clusters that touch are merged back into a single draw.
+class MeshletBuilder
+{
+public:
+	static constexpr unsigned int MaxVertices = 64;
+	static constexpr unsigned int MaxTriangles = 124;
+
+	// Culling volume in the mesh's object space
+	struct Frustum
+	{
+		glm::vec4 planes[6]; // normalized, inside is dot(plane, p) >= 0
+		glm::vec3 eye;
+	};
+
+	// Contiguous slice of the index list that survived culling
+	struct Span
+	{
+		unsigned int firstIndex;
+		unsigned int indexCount;
+	};
+
+	// Meshlets over inds[0, indCount), their firstIndex is offset by firstIndex
+	static std::vector<Meshlet> Build(const Vertex* verts, const unsigned int* inds, size_t indCount,
+		unsigned int firstIndex = 0);
+
+	// Object-space frustum of clipFromObject (projection * view * model)
+	static Frustum ObjectFrustum(const glm::mat4& clipFromObject, const glm::vec3& eyeObject);
+
+	static bool Visible(const Meshlet& meshlet, const Frustum& frustum);
+
+	// Replaces spans with the merged visible ranges, returns the visible triangle count
+	static size_t Cull(const std::vector<Meshlet>& meshlets, const Frustum& frustum, std::vector<Span>& spans);
+};
+
+#endif
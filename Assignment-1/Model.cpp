@@ -1,18 +1,14 @@
 ﻿#include "Model.h"
+#include "Camera.h"
 #include <iostream>
+#include <glm/gtc/type_ptr.hpp>
 #include "stb/stb_image.h"
 
-unsigned int TextureFromFile(const char* path)
+static unsigned int uploadTexture(unsigned char* data, int w, int h)
 {
     unsigned int id;
     glGenTextures(1, &id);
 
-    int w, h, ch;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &w, &h, &ch, STBI_rgb_alpha);
-
-    if (!data) { std::cout << "FAILED TEX LOAD: " << path << "\n"; return 0; }
-
     glBindTexture(GL_TEXTURE_2D, id);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -26,6 +22,29 @@ unsigned int TextureFromFile(const char* path)
     return id;
 }
 
+unsigned int TextureFromFile(const char* path)
+{
+    int w, h, ch;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load(path, &w, &h, &ch, STBI_rgb_alpha);
+
+    if (!data) { std::cout << "FAILED TEX LOAD: " << path << "\n"; return 0; }
+    return uploadTexture(data, w, h);
+}
+
+// Decodes a compressed texture embedded in the model file (GLB "*N") in place
+unsigned int TextureFromMemory(const aiTexture* tex)
+{
+    if (tex->mHeight != 0) { std::cout << "UNSUPPORTED RAW EMBEDDED TEX: " << tex->mFilename.C_Str() << "\n"; return 0; }
+
+    int w, h, ch;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load_from_memory((const stbi_uc*)tex->pcData, (int)tex->mWidth, &w, &h, &ch, STBI_rgb_alpha);
+
+    if (!data) { std::cout << "FAILED EMBEDDED TEX LOAD: " << tex->mFilename.C_Str() << "\n"; return 0; }
+    return uploadTexture(data, w, h);
+}
+
 Model::Model(const char* path) { loadModel(path); }
 
 void Model::Draw(Shader& shader)
@@ -34,6 +53,48 @@ void Model::Draw(Shader& shader)
         mesh.Draw(shader);
 }
 
+void Model::Draw(Shader& shader, const Camera& camera, const glm::mat4& model)
+{
+    glm::mat4 clipFromObject = camera.cameraMatrix * model;
+    glm::vec3 eyeObject = glm::vec3(glm::inverse(model) * glm::vec4(camera.Position, 1.0f));
+
+    drawnTriangles = 0;
+    culledTriangles = 0;
+    for (auto& mesh : meshes)
+    {
+        size_t drawn = mesh.DrawCulled(shader, clipFromObject, eyeObject);
+        drawnTriangles += drawn;
+        culledTriangles += mesh.indices.size() / 3 - drawn;
+    }
+}
+
+void Model::DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+{
+    if (instanceBuffer != instances.ID)
+    {
+        for (auto& mesh : meshes)
+            mesh.SetInstanceBuffer(&instances);
+        instanceBuffer = instances.ID;
+    }
+
+    drawnTriangles = 0;
+    culledTriangles = 0;
+    for (auto& mesh : meshes)
+    {
+        mesh.DrawInstanced(shader, (GLsizei)instances.Count());
+        drawnTriangles += mesh.indices.size() / 3 * instances.Count();
+    }
+}
+
+void Model::DetachInstanceBuffer()
+{
+    if (!instanceBuffer)
+        return;
+    for (auto& mesh : meshes)
+        mesh.SetInstanceBuffer(nullptr);
+    instanceBuffer = 0;
+}
+
 void Model::loadModel(const std::string& path)
 {
     Assimp::Importer importer;
@@ -47,20 +108,38 @@ void Model::loadModel(const std::string& path)
     if (!scene) { std::cout << "ASSIMP ERR " << importer.GetErrorString(); return; }
 
     directory = path.substr(0, path.find_last_of("/\\"));
-    processNode(scene->mRootNode, scene);
+    std::vector<aiMesh*> pending;
+    processNode(scene->mRootNode, SceneGraph::None, scene, pending);
+    nodes.Update();
+
+    meshes.reserve(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+        meshes.push_back(processMesh(pending[i], scene, nodes.World(meshNodes[i])));
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+void Model::processNode(aiNode* node, int parent, const aiScene* scene, std::vector<aiMesh*>& pending)
 {
+    // aiMatrix4x4 is row-major, glm is column-major
+    glm::mat4 local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    int index = nodes.AddNode(parent, local);
+
     for (unsigned i = 0; i < node->mNumMeshes; i++)
-        meshes.push_back(processMesh(scene->mMeshes[node->mMeshes[i]], scene));
+    {
+        pending.push_back(scene->mMeshes[node->mMeshes[i]]);
+        meshNodes.push_back(index);
+    }
 
+    // Depth-first, so every child lands behind its parent
     for (unsigned i = 0; i < node->mNumChildren; i++)
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], index, scene, pending);
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4& world)
 {
+    // One ObjectData matrix covers the whole model, so the node transform is baked into
+    // the vertices. Meshlet bounds and culling then work in model space as before.
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+
     std::vector<Vertex> vertices;
     std::vector<unsigned> indices;
     std::vector<TextureInfo> textures; 
@@ -68,8 +147,8 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
     for (unsigned i = 0; i < mesh->mNumVertices; i++)
     {
         Vertex v;
-        v.Position = { mesh->mVertices[i].x,mesh->mVertices[i].y,mesh->mVertices[i].z };
-        v.Normal = glm::normalize(glm::vec3(
+        v.Position = glm::vec3(world * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f));
+        v.Normal = glm::normalize(normalMatrix * glm::vec3(
             mesh->mNormals[i].x,
             mesh->mNormals[i].y,
             mesh->mNormals[i].z
@@ -95,7 +174,8 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
                     aiString file; mat->GetTexture(type, i, &file);
                     std::string full = directory + "/" + file.C_Str();
                     TextureInfo tex;
-                    tex.id = TextureFromFile(full.c_str());
+                    const aiTexture* embedded = scene->GetEmbeddedTexture(file.C_Str());
+                    tex.id = embedded ? TextureFromMemory(embedded) : TextureFromFile(full.c_str());
                     tex.type = name;
                     tex.path = full;
                     textures.push_back(tex);
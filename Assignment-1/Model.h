@@ -11,22 +11,41 @@
 #include <vector>
 
 #include "Mesh.h"         
+#include "SceneGraph.h"
 #include "Texture.h"
 #include "shaderClass.h"
 
+class Camera;
+
 class Model {
 public:
     std::vector<Mesh> meshes;
     std::vector<TextureInfo> loadedTextures;
 
+    // Triangles submitted / rejected by meshlet culling in the last culled Draw call
+    size_t drawnTriangles = 0;
+    size_t culledTriangles = 0;
+
     Model(const char* path);
     void Draw(Shader& shader);
+    // Culls meshlets against the camera frustum and their normal cones first
+    void Draw(Shader& shader, const Camera& camera, const glm::mat4& model);
+
+    // One instanced draw per mesh for every instance in instances, with a shader built
+    // with the INSTANCED define. Attaches the buffer to the meshes on first use.
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances);
+    // Call before deleting the InstanceBuffer last drawn with
+    void DetachInstanceBuffer();
 
 private:
     std::string directory;
+    GLuint instanceBuffer = 0;  // the InstanceBuffer the mesh VAOs point at
+    // Assimp node hierarchy, meshes[i] was placed by node meshNodes[i]
+    SceneGraph nodes;
+    std::vector<int> meshNodes;
     void loadModel(const std::string& path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    void processNode(aiNode* node, int parent, const aiScene* scene, std::vector<aiMesh*>& pending);
+    Mesh processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4& world);
 };
 
 
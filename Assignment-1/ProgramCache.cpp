@@ -0,0 +1,221 @@
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace
+{
+	// Not part of the 3.3 loader, fetched by ProgramCache::Load
+	typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+	typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+	GetProgramBinaryProc getProgramBinary = nullptr;
+	ProgramBinaryProc programBinary = nullptr;
+	ProgramParameteriProc programParameteri = nullptr;
+
+	const char Directory[] = "programcache";
+	const char Magic[4] = { 'P', 'R', 'G', 'B' };
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t size;
+		double compileMs;
+	};
+
+	// 64-bit FNV-1a, chained through hash
+	uint64_t Fnv1a(const void* data, size_t count, uint64_t hash = 14695981039346656037ull)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < count; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	double msSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+ProgramCache& ProgramCache::Shared()
+{
+	static ProgramCache cache;
+	return cache;
+}
+
+bool ProgramCache::Load(GLADloadproc load)
+{
+	driver.clear();
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* value = (const char*)glGetString(name);
+		driver += value ? value : "";
+		driver += '\n';
+	}
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	getProgramBinary = (GetProgramBinaryProc)load("glGetProgramBinary");
+	programBinary = (ProgramBinaryProc)load("glProgramBinary");
+	programParameteri = (ProgramParameteriProc)load("glProgramParameteri");
+
+	// Both the core and the ARB entry points are only usable with at least one format
+	GLint formats = 0;
+	if (getProgramBinary && programBinary && programParameteri)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats <= 0)
+	{
+		getProgramBinary = nullptr;
+		programBinary = nullptr;
+		programParameteri = nullptr;
+	}
+
+	std::cout << "[ProgramCache] GL " << major << "." << minor << ", "
+		<< (Available() ? "program binaries enabled" : "no program binary formats, compiling every launch") << "\n";
+	return Available();
+}
+
+bool ProgramCache::Available() const
+{
+	return getProgramBinary && programBinary && programParameteri;
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexCode, const std::string& fragmentCode) const
+{
+	// Sizes go in too so text moving between the stages changes the key
+	uint64_t sizes[2] = { vertexCode.size(), fragmentCode.size() };
+	uint64_t hash = Fnv1a(sizes, sizeof(sizes));
+	hash = Fnv1a(vertexCode.data(), vertexCode.size(), hash);
+	hash = Fnv1a(fragmentCode.data(), fragmentCode.size(), hash);
+	return Fnv1a(driver.data(), driver.size(), hash);
+}
+
+std::string ProgramCache::CachePath(uint64_t key)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return std::string(Directory) + "/" + name;
+}
+
+GLuint ProgramCache::Fetch(uint64_t key)
+{
+	if (!Available())
+		return 0;
+
+	auto start = std::chrono::steady_clock::now();
+	std::string path = CachePath(key);
+	std::ifstream in(path, std::ios::binary);
+	Header header;
+	if (!in || !in.read((char*)&header, sizeof(header)) ||
+		std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+		header.version != Version ||
+		header.key != key)
+	{
+		stats.misses++;
+		return 0;
+	}
+
+	std::vector<char> binary(header.size);
+	if (!in.read(binary.data(), binary.size()))
+	{
+		stats.misses++;
+		return 0;
+	}
+	in.close();
+
+	GLuint program = glCreateProgram();
+	programBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		// Same driver strings but the binary is refused, e.g. a changed GPU setting
+		glDeleteProgram(program);
+		std::remove(path.c_str());
+		stats.rejected++;
+		stats.misses++;
+		return 0;
+	}
+
+	double ms = msSince(start);
+	stats.hits++;
+	stats.loadMs += ms;
+	stats.savedMs += header.compileMs - ms;
+	return program;
+}
+
+void ProgramCache::PrepareLink(GLuint program) const
+{
+	if (Available())
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramCache::Store(uint64_t key, GLuint program, double compileMs)
+{
+	stats.compileMs += compileMs;
+	if (!Available())
+		return false;
+
+	GLint linked = GL_FALSE, length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!linked || length <= 0)
+		return false;
+
+	Header header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.key = key;
+	header.compileMs = compileMs;
+
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	getProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return false;
+	header.format = format;
+	header.size = (uint32_t)written;
+
+	std::error_code ec;
+	std::filesystem::create_directories(Directory, ec);
+
+	// Written aside and renamed, a crash never leaves a truncated entry behind
+	std::string path = CachePath(key);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), written);
+		if (!out)
+		{
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(path.c_str());
+	return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
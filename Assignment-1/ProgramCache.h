@@ -0,0 +1,55 @@
+#ifndef PROGRAM_CACHE_CLASS_H
+#define PROGRAM_CACHE_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary, core in
+// GL 4.1 or GL_ARB_get_program_binary). Each program is one file "programcache/<key>.bin",
+// the key hashes both stages' final source text (defines included) together with GL_VENDOR,
+// GL_RENDERER and GL_VERSION, so an edited shader or a new driver simply misses. A binary
+// the driver still rejects is deleted and the program is compiled and stored again.
+class ProgramCache
+{
+public:
+	// Bump whenever the file layout changes
+	static constexpr uint32_t Version = 1;
+
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t rejected = 0;       // files present but refused by the driver
+		double loadMs = 0.0;       // creating programs from binaries
+		double compileMs = 0.0;    // compiling and linking on misses
+		double savedMs = 0.0;      // recorded compile time of every hit minus its load time
+	};
+
+	static ProgramCache& Shared();
+
+	// Fetches the entry points once the context is current. Returns false, and every
+	// lookup misses, if the driver offers no binary formats.
+	bool Load(GLADloadproc load);
+	bool Available() const;
+
+	uint64_t Key(const std::string& vertexCode, const std::string& fragmentCode) const;
+
+	// New program linked from the cached binary, 0 on a miss
+	GLuint Fetch(uint64_t key);
+	// Call before glLinkProgram, some drivers only keep a binary when asked to
+	void PrepareLink(GLuint program) const;
+	// Writes the linked program's binary with the compile time it took, returns false on failure
+	bool Store(uint64_t key, GLuint program, double compileMs);
+
+	const Stats& GetStats() const { return stats; }
+
+	static std::string CachePath(uint64_t key);
+
+private:
+	std::string driver;
+	Stats stats;
+};
+
+#endif
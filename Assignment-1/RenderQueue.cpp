@@ -0,0 +1,73 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Non-negative floats order like their bit patterns, negatives clamp to 0
+	uint32_t depthBits(float depth)
+	{
+		depth = std::max(depth, 0.0f);
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return bits;
+	}
+}
+
+uint64_t RenderQueue::MakeKey(Pass pass, uint32_t program, uint32_t material, float depth)
+{
+	uint64_t state = ((uint64_t)(program & 0xFFF) << 16) | (material & 0xFFFF);
+	uint64_t key = (uint64_t)(pass & 0xF) << 60;
+	if (pass == Transparent)
+		return key | ((uint64_t)~depthBits(depth) << 28) | state;
+	return key | (state << 32) | depthBits(depth);
+}
+
+void RenderQueue::Reserve(size_t count)
+{
+	packets.reserve(count);
+	scratch.reserve(count);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = packets.size();
+	if (count < 2)
+		return;
+
+	// 11-bit digits, six scatter passes instead of eight for bytes. One read fills every histogram.
+	const int DigitBits = 11, Digits = 6, Buckets = 1 << DigitBits;
+	uint32_t histograms[Digits][Buckets] = {};
+	for (const Packet& p : packets)
+		for (int d = 0; d < Digits; d++)
+			histograms[d][(p.key >> (d * DigitBits)) & (Buckets - 1)]++;
+
+	scratch.resize(count);
+	Packet* src = packets.data();
+	Packet* dst = scratch.data();
+	for (int d = 0; d < Digits; d++)
+	{
+		uint32_t* histogram = histograms[d];
+		const unsigned shift = d * DigitBits;
+
+		// Every key has the same digit here, nothing to move
+		if (histogram[(src[0].key >> shift) & (Buckets - 1)] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for (int i = 0; i < Buckets; i++)
+		{
+			uint32_t n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; i++)
+			dst[histogram[(src[i].key >> shift) & (Buckets - 1)]++] = src[i];
+		std::swap(src, dst);
+	}
+
+	// An odd number of passes leaves the result in scratch
+	if (src != packets.data())
+		packets.swap(scratch);
+}
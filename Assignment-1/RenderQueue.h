@@ -0,0 +1,48 @@
+#ifndef RENDER_QUEUE_CLASS_H
+#define RENDER_QUEUE_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-frame list of draw packets ordered by a packed 64-bit key. Systems Submit() a key
+// and the index of their own draw record, Sort() runs an LSD radix sort over the keys,
+// and the caller walks Packets() changing program/material state only where the key
+// says it differs from the previous packet.
+//
+// Key layout, most significant first:
+//   Opaque:      pass:4 | program:12 | material:16 | depth:32  (front to back inside a state bucket)
+//   Transparent: pass:4 | depth:32 inverted | program:12 | material:16  (strictly back to front)
+class RenderQueue
+{
+public:
+	enum Pass : uint32_t
+	{
+		Opaque = 0,
+		Transparent = 1,
+	};
+
+	struct Packet
+	{
+		uint64_t key;
+		uint32_t item;  // caller's draw record
+	};
+
+	// depth is the (non-negative) view distance of the object
+	static uint64_t MakeKey(Pass pass, uint32_t program, uint32_t material, float depth);
+	static Pass PassOf(uint64_t key) { return (Pass)(key >> 60); }
+
+	void Clear() { packets.clear(); }
+	void Reserve(size_t count);
+	void Submit(uint64_t key, uint32_t item) { packets.push_back(Packet{ key, item }); }
+	void Sort();
+
+	const std::vector<Packet>& Packets() const { return packets; }
+	size_t Size() const { return packets.size(); }
+
+private:
+	std::vector<Packet> packets;
+	std::vector<Packet> scratch;
+};
+
+#endif
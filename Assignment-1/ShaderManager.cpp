@@ -0,0 +1,313 @@
+#include "ShaderManager.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "ProgramCache.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace
+{
+	// Not part of the 3.3 loader, fetched by ShaderManager::Load. The KHR and ARB
+	// extensions share the signature and GL_COMPLETION_STATUS.
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+	MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+
+	bool hasExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && std::strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	double msSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	GLuint compile(GLenum stage, const std::string& code)
+	{
+		const char* source = code.c_str();
+		GLuint shader = glCreateShader(stage);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	void printLog(const char* what, GLuint object, bool program)
+	{
+		GLint length = 0;
+		if (program)
+			glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+		else
+			glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+		if (length <= 1)
+			return;
+
+		std::string log(length, '\0');
+		if (program)
+			glGetProgramInfoLog(object, length, nullptr, &log[0]);
+		else
+			glGetShaderInfoLog(object, length, nullptr, &log[0]);
+		std::cerr << what << ":\n" << log.c_str() << "\n";
+	}
+}
+
+bool ShaderManager::Load(GLADloadproc load)
+{
+	maxShaderCompilerThreads = nullptr;
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsKHR");
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)load("glMaxShaderCompilerThreadsARB");
+
+	// All ones lets the driver pick the thread count
+	if (maxShaderCompilerThreads)
+		maxShaderCompilerThreads(0xFFFFFFFFu);
+
+#ifdef __linux__
+	const char* watch = "inotify";
+#else
+	const char* watch = "polled write times";
+#endif
+	std::cout << "[ShaderManager] " << (ParallelCompile() ? "parallel shader compile" : "no parallel shader compile, builds finish on first use")
+		<< ", hot reload through " << watch << "\n";
+	return ParallelCompile();
+}
+
+bool ShaderManager::ParallelCompile() const
+{
+	return maxShaderCompilerThreads != nullptr;
+}
+
+bool ShaderManager::SetFallback(const char* vertexFile, const char* fragmentFile, const char* defines)
+{
+	if (fallback.ID)
+		fallback.Delete();
+	fallback = Shader(vertexFile, fragmentFile, defines);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(fallback.ID, GL_LINK_STATUS, &linked);
+	bindBlocks(fallback);
+	return linked == GL_TRUE;
+}
+
+Shader& ShaderManager::Add(const char* vertexFile, const char* fragmentFile, const char* defines)
+{
+	Entry entry;
+	entry.shader = std::make_unique<Shader>();
+	entry.vertexFile = vertexFile;
+	entry.fragmentFile = fragmentFile;
+	entry.defines = defines ? defines : "";
+	watcher.Watch(entry.vertexFile);
+	watcher.Watch(entry.fragmentFile);
+
+	if (!submit(entry))
+	{
+		std::cerr << "❌ Failed to read shader sources: " << vertexFile << " + " << fragmentFile << std::endl;
+		std::abort();
+	}
+	entries.push_back(std::move(entry));
+	return *entries.back().shader;
+}
+
+void ShaderManager::BindUniformBlock(const char* block, GLuint binding)
+{
+	blockBindings.emplace_back(block, binding);
+	if (fallback.ID)
+		fallback.BindUniformBlock(block, binding);
+	for (const Entry& entry : entries)
+		if (entry.shader->ID)
+			entry.shader->BindUniformBlock(block, binding);
+}
+
+Shader& ShaderManager::Get(Shader& shader)
+{
+	Entry* entry = find(shader);
+	if (entry && !shader.ID && entry->build.program)
+		finish(*entry, !ParallelCompile());
+	if (shader.ID)
+		return shader;
+
+	stats.fallbackUses++;
+	return fallback;
+}
+
+bool ShaderManager::Ready(const Shader& shader) const
+{
+	return shader.ID != 0;
+}
+
+void ShaderManager::WaitAll()
+{
+	for (Entry& entry : entries)
+		if (entry.build.program)
+			finish(entry, true);
+}
+
+void ShaderManager::Update()
+{
+	for (const std::string& path : watcher.Poll())
+	{
+		for (Entry& entry : entries)
+		{
+			if (entry.vertexFile != path && entry.fragmentFile != path)
+				continue;
+
+			// A newer save replaces a build that has not linked yet
+			discard(entry.build);
+			entry.reload = entry.shader->ID != 0;
+			if (!submit(entry))
+				std::cout << "[ShaderManager] " << path << " is unreadable, keeping the current program\n";
+		}
+	}
+
+	// Rebuilds swap in between frames once they are done. Without parallel compile that
+	// is the next Update, which waits for the driver.
+	for (Entry& entry : entries)
+		if (entry.build.program && entry.reload)
+			finish(entry, !ParallelCompile());
+}
+
+void ShaderManager::Delete()
+{
+	for (Entry& entry : entries)
+	{
+		discard(entry.build);
+		if (entry.shader->ID)
+			entry.shader->Delete();
+	}
+	entries.clear();
+	if (fallback.ID)
+		fallback.Delete();
+	fallback = Shader();
+}
+
+ShaderManager::Entry* ShaderManager::find(const Shader& shader)
+{
+	for (Entry& entry : entries)
+		if (entry.shader.get() == &shader)
+			return &entry;
+	return nullptr;
+}
+
+const ShaderManager::Entry* ShaderManager::find(const Shader& shader) const
+{
+	for (const Entry& entry : entries)
+		if (entry.shader.get() == &shader)
+			return &entry;
+	return nullptr;
+}
+
+bool ShaderManager::submit(Entry& entry)
+{
+	const char* defines = entry.defines.empty() ? nullptr : entry.defines.c_str();
+	std::string vertexCode, fragmentCode;
+	try
+	{
+		vertexCode = Shader::ReadSource(entry.vertexFile.c_str(), defines);
+		fragmentCode = Shader::ReadSource(entry.fragmentFile.c_str(), defines);
+	}
+	catch (int)
+	{
+		return false;
+	}
+
+	Build& build = entry.build;
+	build.start = std::chrono::steady_clock::now();
+	ProgramCache& cache = ProgramCache::Shared();
+	build.key = cache.Key(vertexCode, fragmentCode);
+	build.program = cache.Fetch(build.key);
+	build.cached = build.program != 0;
+	if (!build.cached)
+	{
+		// Nothing here queries a status, so with parallel compile none of it waits
+		build.vertexShader = compile(GL_VERTEX_SHADER, vertexCode);
+		build.fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentCode);
+		build.program = glCreateProgram();
+		glAttachShader(build.program, build.vertexShader);
+		glAttachShader(build.program, build.fragmentShader);
+		cache.PrepareLink(build.program);
+		glLinkProgram(build.program);
+		build.compileMs = msSince(build.start);
+	}
+	stats.builds++;
+	return true;
+}
+
+bool ShaderManager::finish(Entry& entry, bool wait)
+{
+	Build& build = entry.build;
+	if (!wait && !build.cached)
+	{
+		GLint done = GL_FALSE;
+		glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done)
+			return false;
+		// Every call polls once until this, so this is the first poll that saw the build done
+		build.compileMs = msSince(build.start);
+	}
+
+	// When waiting, only the time blocked here is added: a build picked up on a later call
+	// may have finished long before, and that gap is not compile time
+	auto linkStart = std::chrono::steady_clock::now();
+	GLint linked = GL_FALSE;
+	glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+	if (wait && !build.cached)
+		build.compileMs += msSince(linkStart);
+	std::string name = entry.vertexFile + " + " + entry.fragmentFile;
+	if (!linked)
+	{
+		std::cerr << "❌ Failed to build program: " << name << std::endl;
+		printLog(entry.vertexFile.c_str(), build.vertexShader, false);
+		printLog(entry.fragmentFile.c_str(), build.fragmentShader, false);
+		printLog("link", build.program, true);
+		discard(build);
+		stats.failures++;
+		return true;
+	}
+
+	if (!build.cached)
+		ProgramCache::Shared().Store(build.key, build.program, build.compileMs);
+	if (entry.reload)
+	{
+		// From the save being picked up to the program drawing
+		stats.reloads++;
+		std::cout << "[ShaderManager] reloaded " << name << " in " << msSince(build.start) << " ms\n";
+	}
+
+	// The linked program does not need its shader objects any more
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+	entry.shader->Adopt(build.program);
+	bindBlocks(*entry.shader);
+	build = Build();
+	entry.reload = false;
+	return true;
+}
+
+void ShaderManager::bindBlocks(const Shader& shader) const
+{
+	for (const auto& binding : blockBindings)
+		shader.BindUniformBlock(binding.first.c_str(), binding.second);
+}
+
+void ShaderManager::discard(Build& build)
+{
+	if (build.vertexShader)
+		glDeleteShader(build.vertexShader);
+	if (build.fragmentShader)
+		glDeleteShader(build.fragmentShader);
+	if (build.program)
+		glDeleteProgram(build.program);
+	build = Build();
+}
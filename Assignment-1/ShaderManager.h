@@ -0,0 +1,99 @@
+#ifndef SHADER_MANAGER_CLASS_H
+#define SHADER_MANAGER_CLASS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+
+#include "FileWatcher.h"
+#include "shaderClass.h"
+
+// Owns the app's Shaders and builds them without blocking the frame. Add() reads the sources
+// and submits compile and link at once. With GL_KHR_parallel_shader_compile (or the ARB
+// version) the driver builds on its own threads and Get() only polls GL_COMPLETION_STATUS,
+// handing out the fallback program until the real one has linked; without it Get() finishes
+// the build the first time the program is needed. Update() rebuilds programs whose source
+// files changed on disk the same way and swaps each one in between frames once it links, the
+// old program draws until then. A build that fails logs its info log and changes nothing.
+class ShaderManager
+{
+public:
+	struct Stats
+	{
+		size_t builds = 0;
+		size_t reloads = 0;
+		size_t failures = 0;
+		size_t fallbackUses = 0;   // Get() calls answered with the fallback
+	};
+
+	// Looks up the parallel compile entry points once the context is current, returns
+	// false if the driver has none and builds finish on first use instead
+	bool Load(GLADloadproc load);
+	bool ParallelCompile() const;
+
+	// Built right away, it has to link since it stands in for everything else
+	bool SetFallback(const char* vertexFile, const char* fragmentFile, const char* defines = nullptr);
+
+	// Submits the build, the reference stays valid until Delete
+	Shader& Add(const char* vertexFile, const char* fragmentFile, const char* defines = nullptr);
+
+	// Applied to the fallback and to every program as soon as it links, reloads included
+	void BindUniformBlock(const char* block, GLuint binding);
+
+	// shader if it has linked, the fallback otherwise
+	Shader& Get(Shader& shader);
+	bool Ready(const Shader& shader) const;
+	// Finishes every outstanding build, for code that needs the real programs now
+	void WaitAll();
+
+	// Picks up changed sources and swaps in rebuilt programs, once per frame before drawing
+	void Update();
+
+	void Delete();
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Build
+	{
+		GLuint program = 0;
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		uint64_t key = 0;
+		bool cached = false;
+		std::chrono::steady_clock::time_point start;
+		double compileMs = 0.0;  // time known to be spent building, never the gaps between calls
+	};
+
+	struct Entry
+	{
+		std::unique_ptr<Shader> shader;
+		std::string vertexFile;
+		std::string fragmentFile;
+		std::string defines;
+		Build build;          // outstanding, program 0 if there is none
+		bool reload = false;  // build replaces a program that is already drawing
+	};
+
+	std::vector<Entry> entries;
+	Shader fallback;
+	std::vector<std::pair<std::string, GLuint>> blockBindings;
+	FileWatcher watcher;
+	Stats stats;
+
+	Entry* find(const Shader& shader);
+	const Entry* find(const Shader& shader) const;
+	// False if a source file could not be read
+	bool submit(Entry& entry);
+	// Swaps the finished build in, false while it is still compiling and wait is off
+	bool finish(Entry& entry, bool wait);
+	void bindBlocks(const Shader& shader) const;
+	static void discard(Build& build);
+};
+
+#endif
@@ -47,7 +47,7 @@ Texture::Texture(const char* imageFile,
 void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 {
     shader.Activate();
-    glUniform1i(glGetUniformLocation(shader.ID, uniform), unit);
+    shader.setInt(uniform, unit);
 }
 
 void Texture::Bind() const
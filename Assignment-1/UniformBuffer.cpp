@@ -0,0 +1,117 @@
+#include "UniformBuffer.h"
+
+#include <cstring>
+#include <iostream>
+
+void UniformBuffer::Create(GLsizeiptr size, GLuint binding)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+void UniformBuffer::Update(const void* data, GLsizeiptr size)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void UniformBuffer::Delete()
+{
+	glDeleteBuffers(1, &ID);
+	ID = 0;
+}
+
+void UniformRing::Create(GLsizeiptr recordSize, size_t recordsPerFrame, GLuint binding, size_t framesInFlight)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+	this->binding = binding;
+	this->recordSize = recordSize;
+	stride = (recordSize + alignment - 1) / alignment * alignment;
+	segmentSize = stride * (GLsizeiptr)recordsPerFrame;
+	segment = 0;
+	fences.assign(framesInFlight, nullptr);
+	staging.clear();
+	staging.reserve((size_t)segmentSize);
+
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, segmentSize * (GLsizeiptr)framesInFlight, nullptr, GL_DYNAMIC_DRAW);
+}
+
+void UniformRing::Delete()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	glDeleteBuffers(1, &ID);
+	ID = 0;
+}
+
+void UniformRing::BeginFrame()
+{
+	segment = (segment + 1) % fences.size();
+	GLsync& fence = fences[segment];
+	if (fence)
+	{
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	staging.clear();
+}
+
+GLintptr UniformRing::Push(const void* data, GLsizeiptr size)
+{
+	if (size > recordSize || (GLsizeiptr)staging.size() + stride > segmentSize)
+	{
+		if (!warnedFull)
+			std::cout << "UniformRing: segment full (" << segmentSize / stride << " records), record dropped\n";
+		warnedFull = true;
+		return -1;
+	}
+
+	GLintptr offset = segmentSize * (GLintptr)segment + (GLintptr)staging.size();
+	size_t start = staging.size();
+	staging.resize(start + (size_t)stride);
+	std::memcpy(staging.data() + start, data, (size_t)size);
+	return offset;
+}
+
+void UniformRing::Flush()
+{
+	if (staging.empty())
+		return;
+
+	// The fence from BeginFrame guarantees the GPU is done with this segment
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, segmentSize * (GLintptr)segment, (GLsizeiptr)staging.size(),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst)
+	{
+		std::memcpy(dst, staging.data(), staging.size());
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, segmentSize * (GLintptr)segment, (GLsizeiptr)staging.size(), staging.data());
+	}
+}
+
+void UniformRing::Bind(GLintptr offset) const
+{
+	if (offset >= 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, ID, offset, recordSize);
+}
+
+void UniformRing::EndFrame()
+{
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
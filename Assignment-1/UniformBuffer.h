@@ -0,0 +1,101 @@
+#ifndef UNIFORM_BUFFER_CLASS_H
+#define UNIFORM_BUFFER_CLASS_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Fixed binding points shared by every program, see Shader::BindUniformBlock
+enum UniformBinding : GLuint
+{
+	FrameBinding = 0,
+	ObjectBinding = 1,
+	MaterialBinding = 2,
+};
+
+// std140 mirror of the FrameData block: camera and light, written once per frame.
+// Each vec3 takes a 16 byte slot, the float after it fills the last 4 bytes.
+struct FrameData
+{
+	glm::mat4 camMatrix;
+	glm::vec3 camPos;
+	float lightAmbient;
+	glm::vec3 lightPos;
+	float lightDiffuse;
+	glm::vec3 lightColor;
+	float lightSpecular;
+};
+static_assert(sizeof(FrameData) == 112, "FrameData must match the std140 block");
+
+// std140 mirror of the ObjectData block: transform and material of one draw
+struct ObjectData
+{
+	glm::mat4 model;
+	float ambientStrength;
+	float specularStrength;
+	float shininess;
+	float roughness;
+};
+static_assert(sizeof(ObjectData) == 80, "ObjectData must match the std140 block");
+
+// std140 mirror of one element of the MaterialData block, the table instanced draws pick
+// from with InstanceData::material. Four floats, so the array stride is 16 bytes.
+struct MaterialParams
+{
+	float ambientStrength;
+	float specularStrength;
+	float shininess;
+	float roughness;
+};
+static_assert(sizeof(MaterialParams) == 16, "MaterialParams must match the std140 array stride");
+
+// Length of the materials array in phong.frag
+constexpr unsigned int MaxMaterials = 16;
+
+// Single uniform buffer kept bound to one binding point
+class UniformBuffer
+{
+public:
+	GLuint ID = 0;
+
+	void Create(GLsizeiptr size, GLuint binding);
+	void Update(const void* data, GLsizeiptr size);
+	void Delete();
+};
+
+// Per-object uniform data packed into one buffer at the driver's offset alignment.
+// The buffer is split into one segment per frame in flight, each frame's records are
+// staged on the CPU and copied in with a single unsynchronized map, and a fence keeps
+// a segment from being rewritten while the GPU may still read it. Draws select their
+// record with glBindBufferRange.
+class UniformRing
+{
+public:
+	GLuint ID = 0;
+
+	void Create(GLsizeiptr recordSize, size_t recordsPerFrame, GLuint binding, size_t framesInFlight = 3);
+	void Delete();
+
+	// Waits for the next segment to be free and starts filling it
+	void BeginFrame();
+	// Stages a record, returns its offset in the buffer or -1 when the segment is full
+	GLintptr Push(const void* data, GLsizeiptr size);
+	// Uploads everything pushed since BeginFrame
+	void Flush();
+	void Bind(GLintptr offset) const;
+	// Fences the segment once the frame's draws are submitted
+	void EndFrame();
+
+private:
+	GLuint binding = 0;
+	GLsizeiptr stride = 0;
+	GLsizeiptr recordSize = 0;
+	GLsizeiptr segmentSize = 0;
+	size_t segment = 0;
+	std::vector<GLsync> fences;
+	std::vector<unsigned char> staging;
+	bool warnedFull = false;
+};
+
+#endif
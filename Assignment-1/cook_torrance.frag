@@ -5,14 +5,26 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform vec3 camPos;
-
-// GUI-controlled
-uniform float lightAmbient;
-uniform float lightDiffuse;
-uniform float roughness;
+// GUI-controlled, see UniformBuffer.h
+layout (std140) uniform FrameData
+{
+    mat4 camMatrix;
+    vec3 camPos;
+    float lightAmbient;
+    vec3 lightPos;
+    float lightDiffuse;
+    vec3 lightColor;
+    float lightSpecular;
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    float ambientStrength;
+    float specularStrength;
+    float shininess;
+    float roughness;
+};
 
 const float PI = 3.14159265359;
 
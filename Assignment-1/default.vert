@@ -4,16 +4,49 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTex;
 
+#ifdef INSTANCED
+// Per-instance data from InstanceBuffer, the matrix takes locations 3-6
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in uint aInstanceMaterial;
+
+flat out uint MaterialIndex;
+#endif
+
 out vec3 FragPos;
 out vec3 Normal;
 
-uniform mat4 camMatrix;
-uniform mat4 model;
+// Shared by every program, see UniformBuffer.h
+layout (std140) uniform FrameData
+{
+    mat4 camMatrix;
+    vec3 camPos;
+    float lightAmbient;
+    vec3 lightPos;
+    float lightDiffuse;
+    vec3 lightColor;
+    float lightSpecular;
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    float ambientStrength;
+    float specularStrength;
+    float shininess;
+    float roughness;
+};
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+#ifdef INSTANCED
+    mat4 world = aInstanceModel;
+    MaterialIndex = aInstanceMaterial;
+#else
+    mat4 world = model;
+#endif
+
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;
 
     gl_Position = camMatrix * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,12 @@
+#version 330 core
+
+// ShaderManager draws with this while the real program is still compiling
+out vec4 FragColor;
+
+in vec3 Normal;
+
+void main()
+{
+    float shade = 0.35 + 0.4 * max(normalize(Normal).y, 0.0);
+    FragColor = vec4(vec3(shade), 1.0);
+}
@@ -5,37 +5,68 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform vec3 camPos;
+// Light and material controls (GUI), see UniformBuffer.h
+layout (std140) uniform FrameData
+{
+    mat4 camMatrix;
+    vec3 camPos;
+    float lightAmbient;
+    vec3 lightPos;
+    float lightDiffuse;
+    vec3 lightColor;
+    float lightSpecular;
+};
+
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    float ambientStrength;
+    float specularStrength;
+    float shininess;
+    float roughness;
+};
 
-// Material controls (GUI)
-uniform float ambientStrength;
-uniform float specularStrength;
-uniform float shininess;
+struct Material
+{
+    float ambientStrength;
+    float specularStrength;
+    float shininess;
+    float roughness;
+};
 
-// Light controls (GUI)
-uniform float lightAmbient;
-uniform float lightDiffuse;
-uniform float lightSpecular;
+#ifdef INSTANCED
+// Per-instance material from InstanceData, see MaterialParams in UniformBuffer.h
+flat in uint MaterialIndex;
+
+layout (std140) uniform MaterialData
+{
+    Material materials[16];
+};
+#endif
 
 void main()
 {
+#ifdef INSTANCED
+    Material material = materials[MaterialIndex];
+#else
+    Material material = Material(ambientStrength, specularStrength, shininess, roughness);
+#endif
+
     vec3 N = normalize(Normal);
     vec3 L = normalize(lightPos - FragPos);
     vec3 V = normalize(camPos - FragPos);
     vec3 H = normalize(L + V);
 
     // Ambient 
-    vec3 ambient = lightAmbient * ambientStrength * lightColor;
+    vec3 ambient = lightAmbient * material.ambientStrength * lightColor;
 
     // Diffuse 
     float diff = max(dot(N, L), 0.0);
     vec3 diffuse = lightDiffuse * diff * lightColor;
 
     // Specular (Blinn-Phong) 
-    float spec = pow(max(dot(N, H), 0.0), shininess);
-    vec3 specular = lightSpecular * specularStrength * spec * lightColor;
+    float spec = pow(max(dot(N, H), 0.0), material.shininess);
+    vec3 specular = lightSpecular * material.specularStrength * spec * lightColor;
 
     vec3 result = ambient + diffuse + specular;
     FragColor = vec4(result, 1.0);
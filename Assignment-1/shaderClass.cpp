@@ -1,5 +1,8 @@
 ﻿#include"shaderClass.h"
 #include <glm/gtc/type_ptr.hpp>  // for glm::value_ptr
+#include <chrono>
+
+#include "ProgramCache.h"
 
 std::string get_file_contents(const char* filename)
 {
@@ -17,26 +20,22 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+// Variant defines have to follow #version, which must stay the first statement
+static void insert_defines(std::string& code, const char* defines)
 {
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
-
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
-
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	glCompileShader(vertexShader);
-
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	glCompileShader(fragmentShader);
+	if (!defines || !*defines)
+		return;
+	size_t version = code.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+	if (lineEnd == std::string::npos)
+		code.insert(0, defines);
+	else
+		code.insert(lineEnd + 1, defines);
+}
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const char* defines)
+{
+	// ReadSource throws on a missing file, name it before that happens
 	std::ifstream vertFile(vertexFile);
 	if (!vertFile.is_open())
 	{
@@ -50,33 +49,177 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 		std::abort();
 	}
 
+	std::string vertexCode = ReadSource(vertexFile, defines);
+	std::string fragmentCode = ReadSource(fragmentFile, defines);
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// Same source on the same driver links straight from the stored binary
+	ProgramCache& cache = ProgramCache::Shared();
+	uint64_t key = cache.Key(vertexCode, fragmentCode);
+	ID = cache.Fetch(key);
+	if (!ID)
+	{
+		auto start = std::chrono::steady_clock::now();
+		const char* vertexSource = vertexCode.c_str();
+		const char* fragmentSource = fragmentCode.c_str();
+
+		GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertexShader, 1, &vertexSource, NULL);
+		glCompileShader(vertexShader);
+
+		GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+		glCompileShader(fragmentShader);
+
+		ID = glCreateProgram();
+		glAttachShader(ID, vertexShader);
+		glAttachShader(ID, fragmentShader);
+		cache.PrepareLink(ID);
+		glLinkProgram(ID);
+
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+
+		// Reading the link status waits for the driver, so the time covers the whole build
+		GLint linked = GL_FALSE;
+		glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+		double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (linked)
+			cache.Store(key, ID, compileMs);
+		else
+			std::cerr << "❌ Failed to link program: " << vertexFile << " + " << fragmentFile << std::endl;
+	}
 
+	reflectUniforms();
 }
 
+Shader::Shader() : ID(0)
+{
+}
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::Adopt(GLuint program)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	if (ID)
+		glDeleteProgram(ID);
+	ID = program;
+	reflectUniforms();
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+std::string Shader::ReadSource(const char* file, const char* defines)
+{
+	std::string code = get_file_contents(file);
+	insert_defines(code, defines);
+	return code;
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::reflectUniforms()
+{
+	std::shared_ptr<UniformTable> table = std::make_shared<UniformTable>();
+	std::vector<GLint> locations;
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> buffer(maxLength + 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+		std::string name(buffer.data(), length);
+
+		// Uniform block members have no location
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		if (location < 0)
+			continue;
+
+		// Arrays come back as "name[0]", register the bare name and every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			std::string base = name.substr(0, name.size() - 3);
+			table->names.push_back(base);
+			locations.push_back(location);
+			for (GLint e = 0; e < size; e++)
+			{
+				std::string element = base + "[" + std::to_string(e) + "]";
+				table->names.push_back(element);
+				locations.push_back(glGetUniformLocation(ID, element.c_str()));
+			}
+		}
+		else
+		{
+			table->names.push_back(name);
+			locations.push_back(location);
+		}
+	}
+
+	// names is complete, so the views stay valid
+	for (size_t i = 0; i < table->names.size(); i++)
+		table->locations.emplace(table->names[i], locations[i]);
+	uniforms = std::move(table);
+}
+
+GLint Shader::Location(std::string_view name) const
+{
+	if (!uniforms)
+		return -1;
+	auto it = uniforms->locations.find(name);
+	return it == uniforms->locations.end() ? -1 : it->second;
+}
+
+void Shader::BindUniformBlock(const char* block, GLuint binding) const
+{
+	GLuint index = glGetUniformBlockIndex(ID, block);
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, index, binding);
 }
 
-void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+void Shader::setInt(std::string_view name, int value) const
+{
+	glUniform1i(Location(name), value);
+}
+
+void Shader::setMat4(std::string_view name, const glm::mat4& mat) const {
+	glUniformMatrix4fv(Location(name), 1, GL_FALSE, glm::value_ptr(mat));
+}
+
+void Shader::setVec3(std::string_view name, const glm::vec3& value) const {
+	glUniform3fv(Location(name), 1, &value[0]);
+}
+
+void Shader::setBool(std::string_view name, bool value) const {
+    glUniform1i(Location(name), (int)value);
+}
+
+void Shader::setFloat(std::string_view name, float value) const
+{
+	glUniform1f(Location(name), value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const
+{
+	glUniform1i(uniform.location, value);
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+	glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const
+{
+	glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+	glUniform3fv(uniform.location, 1, &value[0]);
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 
@@ -5,12 +5,17 @@ out vec4 FragColor;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-
-// GUI-controlled light parameters
-uniform float lightAmbient;
-uniform float lightDiffuse;
+// GUI-controlled light parameters, see UniformBuffer.h
+layout (std140) uniform FrameData
+{
+    mat4 camMatrix;
+    vec3 camPos;
+    float lightAmbient;
+    vec3 lightPos;
+    float lightDiffuse;
+    vec3 lightColor;
+    float lightSpecular;
+};
 
 void main()
 {
@@ -0,0 +1,82 @@
+#include "AssetRegistry.h"
+#include "MeshCache.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+	std::string canonicalPath(const std::string& path)
+	{
+		std::error_code ec;
+		std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+		return ec ? path : canonical.generic_string();
+	}
+}
+
+AssetRegistry& AssetRegistry::Shared()
+{
+	static AssetRegistry registry;
+	return registry;
+}
+
+std::shared_ptr<const Model> AssetRegistry::reuse(const std::shared_ptr<const Model>& model, const char* reason,
+	const std::string& path)
+{
+	stats.loadsAvoided++;
+	stats.bytesSaved += model->GpuBytes();
+	std::cout << "[AssetRegistry] " << path << ": shared (" << reason << "), "
+		<< model->GpuBytes() << " bytes saved\n";
+	return model;
+}
+
+std::shared_ptr<const Model> AssetRegistry::LoadModel(const std::string& path, unsigned int options)
+{
+	const std::string suffix = "|" + std::to_string(options);
+	const std::string pathKey = canonicalPath(path) + suffix;
+
+	auto pathIt = byPath.find(pathKey);
+	if (pathIt != byPath.end())
+	{
+		if (std::shared_ptr<const Model> model = pathIt->second.model.lock())
+			return reuse(model, "same path", path);
+	}
+
+	// Same bytes under another name
+	uint64_t hash = MeshCache::HashFile(path);
+	const std::string contentKey = std::to_string(hash) + suffix;
+	if (hash != 0)
+	{
+		auto contentIt = byContent.find(contentKey);
+		if (contentIt != byContent.end())
+		{
+			if (std::shared_ptr<const Model> model = contentIt->second.lock())
+			{
+				byPath[pathKey] = Entry{ model, hash };
+				return reuse(model, "same content", path);
+			}
+		}
+	}
+
+	// The hash goes down to MeshCache, so the source is only read once for it
+	std::shared_ptr<const Model> model = std::make_shared<const Model>(path.c_str(), options, hash);
+	stats.loads++;
+
+	// A failed import is not registered, later requests for the path try again
+	if (model->meshes.empty())
+		return model;
+
+	byPath[pathKey] = Entry{ model, hash };
+	if (hash != 0)
+		byContent[contentKey] = model;
+	return model;
+}
+
+size_t AssetRegistry::LiveModels() const
+{
+	size_t live = 0;
+	for (const auto& entry : byContent)
+		if (!entry.second.expired())
+			live++;
+	return live;
+}
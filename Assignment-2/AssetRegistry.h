@@ -0,0 +1,50 @@
+#ifndef ASSET_REGISTRY_CLASS_H
+#define ASSET_REGISTRY_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Model.h"
+
+// Hands out shared, immutable Models so every scene object that names the same file
+// references one set of GPU buffers. Models are keyed by canonical path, and on a path
+// miss by a hash of the file contents, so copies of one asset under different names
+// are also uploaded once. The registry only holds weak references: a Model is freed
+// when the last handle goes away. GL thread only.
+class AssetRegistry
+{
+public:
+	struct Stats
+	{
+		size_t loads = 0;          // Models actually imported
+		size_t loadsAvoided = 0;   // requests served from an existing Model
+		size_t bytesSaved = 0;     // GPU buffer memory those requests would have allocated
+	};
+
+	std::shared_ptr<const Model> LoadModel(const std::string& path, unsigned int options = Model::OptimizeMeshes);
+
+	const Stats& GetStats() const { return stats; }
+	size_t LiveModels() const;
+
+	static AssetRegistry& Shared();
+
+private:
+	struct Entry
+	{
+		std::weak_ptr<const Model> model;
+		uint64_t contentHash = 0;
+	};
+
+	// Both keys include the load options, they change the uploaded buffers
+	std::unordered_map<std::string, Entry> byPath;
+	std::unordered_map<std::string, std::weak_ptr<const Model>> byContent;
+	Stats stats;
+
+	std::shared_ptr<const Model> reuse(const std::shared_ptr<const Model>& model, const char* reason,
+		const std::string& path);
+};
+
+#endif
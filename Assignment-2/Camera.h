@@ -27,6 +27,9 @@ public:
 	// Stores the width and height of the window
 	int width;
 	int height;
+	// Projection of the last updateMatrix call, used for screen-space LOD selection
+	float fovRadians = glm::radians(45.0f);
+	float nearPlane = 0.1f;
 	bool cinematicMode = false;
 	float cinematicAngle = 0.0f;
 	float cinematicDistance = 85.0f; // distance from planet
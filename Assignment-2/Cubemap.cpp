@@ -2,8 +2,8 @@
 
 Cubemap::Cubemap(int resolution) : size(resolution) {
     // Generates an OpenGL texture object
-    glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+    ID = GenTexture();
+    GLState::BindTexture(GL_TEXTURE_CUBE_MAP, ID.get());
 
     // Allocate 6 faces (empty for now)
     for (int i = 0; i < 6; ++i) {
@@ -25,6 +25,5 @@ Cubemap::Cubemap(int resolution) : size(resolution) {
 }
 
 void Cubemap::Bind(GLuint unit) const {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+    GLState::BindTexture(unit, GL_TEXTURE_CUBE_MAP, ID.get());
 }
@@ -2,9 +2,11 @@
 
 #include <glad/glad.h>
 
+#include "GLHandle.h"
+
 class Cubemap {
 public:
-    GLuint ID = 0;
+    TextureHandle ID;
     int size = 0;
 
     Cubemap(int resolution);
@@ -0,0 +1,225 @@
+#include "DrawBatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.h"
+#include "TextureCache.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace
+{
+	// Not part of the 3.3 loader, fetched by LoadMultiDraw
+	typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+	MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+	bool multiDrawEnabled = true;
+
+	const GLuint FirstLocation = 3;
+
+	bool hasExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && std::strcmp(extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// DrawData as attributes 3-8 with a divisor of 1, for the buffer bound to GL_ARRAY_BUFFER
+	void setDrawDataAttributes()
+	{
+		for (GLuint column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(FirstLocation + column);
+			glVertexAttribPointer(FirstLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(DrawData),
+				(void*)(offsetof(DrawData, model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(FirstLocation + column, 1);
+		}
+		glEnableVertexAttribArray(FirstLocation + 4);
+		glVertexAttribPointer(FirstLocation + 4, 3, GL_FLOAT, GL_FALSE, sizeof(DrawData), (void*)offsetof(DrawData, posOffset));
+		glVertexAttribDivisor(FirstLocation + 4, 1);
+		glEnableVertexAttribArray(FirstLocation + 5);
+		glVertexAttribPointer(FirstLocation + 5, 3, GL_FLOAT, GL_FALSE, sizeof(DrawData), (void*)offsetof(DrawData, posScale));
+		glVertexAttribDivisor(FirstLocation + 5, 1);
+	}
+
+	// Arrays off, so the shader reads the constant values set per draw
+	void disableDrawDataAttributes()
+	{
+		for (GLuint location = FirstLocation; location < FirstLocation + 6; location++)
+			glDisableVertexAttribArray(location);
+	}
+
+	void setDrawDataConstants(const DrawData& d)
+	{
+		for (GLuint column = 0; column < 4; column++)
+			glVertexAttrib4fv(FirstLocation + column, &d.model[column][0]);
+		glVertexAttrib3fv(FirstLocation + 4, &d.posOffset[0]);
+		glVertexAttrib3fv(FirstLocation + 5, &d.posScale[0]);
+	}
+
+	// Orphans and refills, the name and therefore the VAO attribute bindings stay valid
+	void upload(GLenum target, BufferHandle& buffer, const void* data, size_t bytes)
+	{
+		if (!buffer)
+			buffer = GenBuffer();
+		glBindBuffer(target, buffer.get());
+		glBufferData(target, bytes, data, GL_STREAM_DRAW);
+	}
+}
+
+bool DrawBatch::LoadMultiDraw(GLADloadproc load)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool core = major > 4 || (major == 4 && minor >= 3);
+	bool extensions = hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance");
+
+	multiDrawElementsIndirect = nullptr;
+	if (core || extensions)
+		multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+
+	std::cout << "[DrawBatch] GL " << major << "." << minor << ", "
+		<< (multiDrawElementsIndirect ? "glMultiDrawElementsIndirect" : "base-vertex fallback") << "\n";
+	return multiDrawElementsIndirect != nullptr;
+}
+
+bool DrawBatch::MultiDrawAvailable()
+{
+	return multiDrawElementsIndirect != nullptr;
+}
+
+void DrawBatch::SetMultiDraw(bool enabled)
+{
+	multiDrawEnabled = enabled;
+}
+
+void DrawBatch::Clear()
+{
+	for (Bucket& bucket : buckets)
+		bucket.commands.clear();
+	buckets.clear();
+	meshBuckets.clear();
+	keyBuckets.clear();
+	drawData.clear();
+	commands.clear();
+}
+
+size_t DrawBatch::bucketFor(const Mesh& mesh)
+{
+	auto known = meshBuckets.find(&mesh);
+	if (known != meshBuckets.end())
+		return known->second;
+
+	GLuint vao = mesh.pooled ? mesh.pooled.Pool()->VAO() : mesh.VAO.get();
+	std::vector<GLuint> key = { vao, mesh.indexType, (GLuint)mesh.format };
+	for (const TextureInfo& t : mesh.textures)
+		key.push_back(t.texture ? t.texture->id.get() : 0);
+
+	auto inserted = keyBuckets.emplace(std::move(key), buckets.size());
+	if (inserted.second)
+		buckets.push_back(Bucket{ &mesh, vao, mesh.indexType, {} });
+	meshBuckets.emplace(&mesh, inserted.first->second);
+	return inserted.first->second;
+}
+
+void DrawBatch::Add(const Mesh& mesh, const glm::mat4& world, size_t lod)
+{
+	if (lod >= mesh.lods.size())
+		return;
+
+	Bucket& bucket = buckets[bucketFor(mesh)];
+	GLuint record = (GLuint)drawData.size();
+	drawData.push_back(DrawData{ world, mesh.posOffset, mesh.posScale });
+
+	// Same split as Mesh::drawSpan, one command per 16-bit range
+	const GeometryPool::Allocation& a = mesh.pooled.Get();
+	size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	GLuint firstIndex = (GLuint)(a.indexOffset / indexSize);
+	unsigned int first = mesh.lods[lod].firstIndex;
+	unsigned int end = first + mesh.lods[lod].indexCount;
+	for (unsigned int i = mesh.lodRangeStart[lod]; i < mesh.lodRangeStart[lod + 1]; i++)
+	{
+		const IndexRange& r = mesh.ranges[i];
+		unsigned int lo = std::max(first, r.first);
+		unsigned int hi = std::min(end, r.first + r.count);
+		if (lo < hi)
+			bucket.commands.push_back(Command{ hi - lo, 1, firstIndex + lo, (GLint)a.firstVertex + r.baseVertex, record });
+	}
+}
+
+void DrawBatch::Draw(Shader& shader)
+{
+	stats = Stats();
+	stats.draws = drawData.size();
+	stats.buckets = buckets.size();
+	if (drawData.empty())
+		return;
+
+	bool multiDraw = multiDrawEnabled && multiDrawElementsIndirect;
+	if (multiDraw)
+	{
+		commands.clear();
+		for (const Bucket& bucket : buckets)
+			commands.insert(commands.end(), bucket.commands.begin(), bucket.commands.end());
+		upload(GL_ARRAY_BUFFER, drawDataBuffer, drawData.data(), drawData.size() * sizeof(DrawData));
+		upload(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commands.data(), commands.size() * sizeof(Command));
+	}
+
+	shader.Activate();
+	size_t offset = 0;
+	for (const Bucket& bucket : buckets)
+	{
+		stats.commands += bucket.commands.size();
+		if (bucket.commands.empty())
+			continue;
+
+		bucket.material->BindMaterial(shader);
+		GLState::BindVertexArray(bucket.vao);
+		if (multiDraw)
+		{
+			// Other batches may have pointed this VAO elsewhere, re-pointing is per bucket not per draw
+			glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer.get());
+			setDrawDataAttributes();
+			multiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType, (void*)(offset * sizeof(Command)),
+				(GLsizei)bucket.commands.size(), 0);
+			stats.submits++;
+			Mesh::counters.drawCalls++;
+		}
+		else
+		{
+			drawFallback(bucket);
+		}
+		offset += bucket.commands.size();
+	}
+	if (multiDraw)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DrawBatch::drawFallback(const Bucket& bucket)
+{
+	disableDrawDataAttributes();
+	size_t indexSize = bucket.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	GLuint current = ~0u;
+	for (const Command& c : bucket.commands)
+	{
+		if (c.baseInstance != current)
+		{
+			setDrawDataConstants(drawData[c.baseInstance]);
+			current = c.baseInstance;
+		}
+		glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)c.count, bucket.indexType,
+			(void*)((size_t)c.firstIndex * indexSize), c.baseVertex);
+		stats.submits++;
+		Mesh::counters.drawCalls++;
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef DRAW_BATCH_CLASS_H
+#define DRAW_BATCH_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLHandle.h"
+#include "Mesh.h"
+
+// Per-draw record read by the DRAW_DATA variant of vertex.glsl (attributes 3-8)
+struct DrawData
+{
+	glm::mat4 model;
+	glm::vec3 posOffset;
+	glm::vec3 posScale;
+};
+
+// Collects mesh draws for one program and submits them per bucket of meshes that share
+// a VAO, index type and material. With GL 4.3 (or ARB_multi_draw_indirect +
+// ARB_base_instance) a bucket is a single glMultiDrawElementsIndirect whose baseInstance
+// picks the draw's DrawData, so the CPU cost no longer grows with the object count. On a
+// plain 3.3 context every command becomes a glDrawElementsBaseVertex with the DrawData
+// set as constant vertex attributes instead. Meshes from a shared GeometryPool all land
+// in the same VAO, which is what makes the buckets large.
+class DrawBatch
+{
+public:
+	// GL's DrawElementsIndirectCommand
+	struct Command
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct Stats
+	{
+		size_t draws = 0;     // DrawData records
+		size_t commands = 0;  // index ranges
+		size_t buckets = 0;
+		size_t submits = 0;   // GL draw calls issued by the last Draw
+	};
+
+	// Looks up glMultiDrawElementsIndirect once the context is current. Returns false, and
+	// every batch keeps using the base-vertex fallback, when the context cannot do it.
+	static bool LoadMultiDraw(GLADloadproc load);
+	static bool MultiDrawAvailable();
+	// Forces the fallback even where multi-draw is available, for comparisons
+	static void SetMultiDraw(bool enabled);
+
+	// Starts a new frame, keeps the allocations
+	void Clear();
+	// Queues one LOD of mesh with its object-to-world transform
+	void Add(const Mesh& mesh, const glm::mat4& world, size_t lod = 0);
+	// Uploads the frame's records and commands and draws every bucket with shader, which
+	// has to be built with the DRAW_DATA define. Leaves the last bucket's VAO bound.
+	void Draw(Shader& shader);
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Bucket
+	{
+		const Mesh* material;  // first mesh added, binds the bucket's textures
+		GLuint vao;
+		GLenum indexType;
+		std::vector<Command> commands;
+	};
+
+	std::vector<Bucket> buckets;
+	// Bucket of every mesh added this frame, and of every (vao, index type, format, textures) key
+	std::unordered_map<const Mesh*, size_t> meshBuckets;
+	std::map<std::vector<GLuint>, size_t> keyBuckets;
+	std::vector<DrawData> drawData;
+	std::vector<Command> commands;  // all buckets back to back for the upload
+
+	BufferHandle drawDataBuffer;
+	BufferHandle commandBuffer;
+	Stats stats;
+
+	size_t bucketFor(const Mesh& mesh);
+	void drawFallback(const Bucket& bucket);
+};
+
+#endif
@@ -3,15 +3,15 @@
 // Constructor that generates a Elements Buffer Object and links it to indices
 EBO::EBO(GLuint* indices, GLsizeiptr size)
 {
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	ID = GenBuffer();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID.get());
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
 }
 
 // Binds the EBO
 void EBO::Bind()
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID.get());
 }
 
 // Unbinds the EBO
@@ -23,5 +23,5 @@ void EBO::Unbind()
 // Deletes the EBO
 void EBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	ID.reset();
 }
\ No newline at end of file
@@ -2,12 +2,13 @@
 #define EBO_CLASS_H
 
 #include<glad/glad.h>
+#include"GLHandle.h"
 
 class EBO
 {
 public:
-	// ID reference of Elements Buffer Object
-	GLuint ID;
+	// Owning reference of Elements Buffer Object, deleted with the EBO
+	BufferHandle ID;
 	// Constructor that generates a Elements Buffer Object and links it to indices
 	EBO(GLuint* indices, GLsizeiptr size);
 
@@ -15,7 +16,7 @@ public:
 	void Bind();
 	// Unbinds the EBO
 	void Unbind();
-	// Deletes the EBO
+	// Deletes the EBO before the destructor would
 	void Delete();
 };
 
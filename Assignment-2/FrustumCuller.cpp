@@ -0,0 +1,164 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX 1
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+
+void FrustumCuller::Clear()
+{
+	for (std::vector<float>* v : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+		v->clear();
+	visible.clear();
+	visibleObjects.clear();
+}
+
+void FrustumCuller::Reserve(size_t count)
+{
+	for (std::vector<float>* v : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius })
+		v->reserve(count);
+	visible.reserve(count);
+	visibleObjects.reserve(count);
+}
+
+uint32_t FrustumCuller::Add(const Bounds& bounds, const glm::mat4& world)
+{
+	// Box: center through the full matrix, half extents through |upper 3x3| (Arvo)
+	glm::vec3 center = glm::vec3(world * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+	glm::vec3 extent(0.0f);
+	for (int column = 0; column < 3; column++)
+		extent += glm::abs(glm::vec3(world[column])) * half[column];
+
+	// Sphere around the box center, so both volumes share one center
+	float scale = std::max(glm::length(glm::vec3(world[0])),
+		std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+	glm::vec3 sphereCenter = glm::vec3(world * glm::vec4(bounds.center, 1.0f));
+	float sphereRadius = bounds.radius * scale + glm::length(sphereCenter - center);
+
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+	radius.push_back(sphereRadius);
+	return (uint32_t)(centerX.size() - 1);
+}
+
+bool FrustumCuller::testOne(size_t i, const MeshletBuilder::Frustum& frustum) const
+{
+	for (const glm::vec4& p : frustum.planes)
+	{
+		float d = p.x * centerX[i] + p.y * centerY[i] + p.z * centerZ[i] + p.w;
+		float box = std::abs(p.x) * extentX[i] + std::abs(p.y) * extentY[i] + std::abs(p.z) * extentZ[i];
+		if (d + std::min(box, radius[i]) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+size_t FrustumCuller::finish()
+{
+	visibleObjects.clear();
+	for (size_t i = 0; i < visible.size(); i++)
+		if (visible[i])
+			visibleObjects.push_back((uint32_t)i);
+
+	stats.tested = visible.size();
+	stats.visible = visibleObjects.size();
+	stats.culled = stats.tested - stats.visible;
+	return stats.visible;
+}
+
+size_t FrustumCuller::CullScalar(const MeshletBuilder::Frustum& frustum)
+{
+	const size_t count = Size();
+	visible.resize(count);
+	for (size_t i = 0; i < count; i++)
+		visible[i] = testOne(i, frustum) ? 1 : 0;
+	return finish();
+}
+
+size_t FrustumCuller::Cull(const MeshletBuilder::Frustum& frustum)
+{
+	const size_t count = Size();
+	visible.resize(count);
+	size_t i = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	__m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		px[p] = _mm256_set1_ps(plane.x);
+		py[p] = _mm256_set1_ps(plane.y);
+		pz[p] = _mm256_set1_ps(plane.z);
+		pw[p] = _mm256_set1_ps(plane.w);
+		ax[p] = _mm256_set1_ps(std::abs(plane.x));
+		ay[p] = _mm256_set1_ps(std::abs(plane.y));
+		az[p] = _mm256_set1_ps(std::abs(plane.z));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&centerX[i]), cy = _mm256_loadu_ps(&centerY[i]), cz = _mm256_loadu_ps(&centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&extentX[i]), ey = _mm256_loadu_ps(&extentY[i]), ez = _mm256_loadu_ps(&extentZ[i]);
+		__m256 r = _mm256_loadu_ps(&radius[i]);
+		__m256 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			// Same summation order as testOne, so lanes and the scalar tail always agree
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], cx), _mm256_mul_ps(py[p], cy)),
+				_mm256_mul_ps(pz[p], cz)), pw[p]);
+			__m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)), _mm256_mul_ps(az[p], ez));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(d, _mm256_min_ps(box, r)), zero, _CMP_LT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; lane++)
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+	}
+#elif defined(FRUSTUM_CULLER_SSE)
+	__m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		px[p] = _mm_set1_ps(plane.x);
+		py[p] = _mm_set1_ps(plane.y);
+		pz[p] = _mm_set1_ps(plane.z);
+		pw[p] = _mm_set1_ps(plane.w);
+		ax[p] = _mm_set1_ps(std::abs(plane.x));
+		ay[p] = _mm_set1_ps(std::abs(plane.y));
+		az[p] = _mm_set1_ps(std::abs(plane.z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[i]), cy = _mm_loadu_ps(&centerY[i]), cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]), ey = _mm_loadu_ps(&extentY[i]), ez = _mm_loadu_ps(&extentZ[i]);
+		__m128 r = _mm_loadu_ps(&radius[i]);
+		__m128 outside = zero;
+		for (int p = 0; p < 6; p++)
+		{
+			// Same summation order as testOne, so lanes and the scalar tail always agree
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+				_mm_mul_ps(pz[p], cz)), pw[p]);
+			__m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, _mm_min_ps(box, r)), zero));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+	}
+#endif
+
+	for (; i < count; i++)
+		visible[i] = testOne(i, frustum) ? 1 : 0;
+	return finish();
+}
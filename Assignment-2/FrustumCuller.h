@@ -0,0 +1,64 @@
+#ifndef FRUSTUM_CULLER_CLASS_H
+#define FRUSTUM_CULLER_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "MeshletBuilder.h"
+
+// Object-space bounding volumes, both contain the whole object
+struct Bounds
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+	glm::vec3 center = glm::vec3(0.0f);  // sphere
+	float radius = 0.0f;
+};
+
+// Frustum culling of many objects at once. Add() moves each object's bounds to world
+// space (box by the absolute matrix, sphere by the largest axis scale) into structure of
+// arrays storage, Cull() then tests 8 (AVX) or 4 (SSE) objects per iteration against all
+// six planes. Per plane an object is outside when its center is further behind it than
+// the smaller of its box and sphere extents.
+class FrustumCuller
+{
+public:
+	struct Stats
+	{
+		size_t tested = 0;
+		size_t visible = 0;
+		size_t culled = 0;
+	};
+
+	void Clear();
+	void Reserve(size_t count);
+	// Returns the object's index for Visible()
+	uint32_t Add(const Bounds& bounds, const glm::mat4& world);
+
+	// World-space frustum: MeshletBuilder::ObjectFrustum(camera.cameraMatrix, camera.Position)
+	size_t Cull(const MeshletBuilder::Frustum& frustum);
+	// Plain loop over the same data, for comparison and for platforms without SSE
+	size_t CullScalar(const MeshletBuilder::Frustum& frustum);
+
+	size_t Size() const { return centerX.size(); }
+	bool Visible(uint32_t object) const { return visible[object] != 0; }
+	// Objects that passed the last Cull, in Add order
+	const std::vector<uint32_t>& VisibleObjects() const { return visibleObjects; }
+	const Stats& GetStats() const { return stats; }
+
+private:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	std::vector<uint8_t> visible;
+	std::vector<uint32_t> visibleObjects;
+	Stats stats;
+
+	bool testOne(size_t i, const MeshletBuilder::Frustum& frustum) const;
+	size_t finish();
+};
+
+#endif
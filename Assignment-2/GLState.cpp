@@ -0,0 +1,188 @@
+#include "GLState.h"
+
+GLState::Counters GLState::counters;
+
+GLuint GLState::program = GLState::Unknown;
+GLuint GLState::vao = GLState::Unknown;
+GLuint GLState::fbo = GLState::Unknown;
+GLuint GLState::activeUnit = GLState::Unknown;
+GLuint GLState::textures[GLState::MaxTextureUnits][2];
+signed char GLState::depthTest = -1;
+signed char GLState::depthMask = -1;
+signed char GLState::cullFace = -1;
+GLenum GLState::depthFunc = GLState::Unknown;
+GLint GLState::viewport[4];
+bool GLState::viewportKnown = false;
+
+namespace
+{
+	// Slot in GLState::textures, -1 for targets that are not tracked
+	int targetSlot(GLenum target)
+	{
+		if (target == GL_TEXTURE_2D)
+			return 0;
+		if (target == GL_TEXTURE_CUBE_MAP)
+			return 1;
+		return -1;
+	}
+
+	// The texture table has no constructor, fill it before main() runs any setter
+	struct TextureTableInit
+	{
+		TextureTableInit() { GLState::Invalidate(); }
+	} textureTableInit;
+}
+
+bool GLState::UseProgram(GLuint id)
+{
+	if (!changed(program != id))
+		return false;
+	glUseProgram(id);
+	program = id;
+	return true;
+}
+
+bool GLState::BindVertexArray(GLuint id)
+{
+	if (!changed(vao != id))
+		return false;
+	glBindVertexArray(id);
+	vao = id;
+	return true;
+}
+
+bool GLState::BindFramebuffer(GLuint id)
+{
+	if (!changed(fbo != id))
+		return false;
+	glBindFramebuffer(GL_FRAMEBUFFER, id);
+	fbo = id;
+	return true;
+}
+
+bool GLState::ActiveTexture(GLuint unit)
+{
+	if (!changed(activeUnit != unit))
+		return false;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	activeUnit = unit;
+	return true;
+}
+
+bool GLState::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int slot = targetSlot(target);
+	if (slot >= 0 && unit < MaxTextureUnits && !changed(textures[unit][slot] != texture))
+		return false;
+	ActiveTexture(unit);
+	glBindTexture(target, texture);
+	if (slot >= 0 && unit < MaxTextureUnits)
+		textures[unit][slot] = texture;
+	return true;
+}
+
+bool GLState::BindTexture(GLenum target, GLuint texture)
+{
+	if (activeUnit == Unknown)
+		ActiveTexture(0);
+	return BindTexture(activeUnit, target, texture);
+}
+
+bool GLState::setCapability(signed char& cached, GLenum cap, bool enabled)
+{
+	if (!changed(cached != (signed char)enabled))
+		return false;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	cached = (signed char)enabled;
+	return true;
+}
+
+bool GLState::SetDepthTest(bool enabled)
+{
+	return setCapability(depthTest, GL_DEPTH_TEST, enabled);
+}
+
+bool GLState::SetCullFace(bool enabled)
+{
+	return setCapability(cullFace, GL_CULL_FACE, enabled);
+}
+
+bool GLState::SetDepthMask(bool enabled)
+{
+	if (!changed(depthMask != (signed char)enabled))
+		return false;
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	depthMask = (signed char)enabled;
+	return true;
+}
+
+bool GLState::SetDepthFunc(GLenum func)
+{
+	if (!changed(depthFunc != func))
+		return false;
+	glDepthFunc(func);
+	depthFunc = func;
+	return true;
+}
+
+bool GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	bool same = viewportKnown && viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height;
+	if (!changed(!same))
+		return false;
+	glViewport(x, y, width, height);
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+	viewportKnown = true;
+	return true;
+}
+
+bool GLState::GetViewport(GLint out[4])
+{
+	if (!viewportKnown)
+		return false;
+	for (int i = 0; i < 4; i++)
+		out[i] = viewport[i];
+	return true;
+}
+
+void GLState::ForgetProgram(GLuint id)
+{
+	if (program == id)
+		program = Unknown;
+}
+
+void GLState::ForgetVertexArray(GLuint id)
+{
+	if (vao == id)
+		vao = Unknown;
+}
+
+void GLState::ForgetTexture(GLuint id)
+{
+	for (GLuint unit = 0; unit < MaxTextureUnits; unit++)
+		for (GLuint& bound : textures[unit])
+			if (bound == id)
+				bound = Unknown;
+}
+
+void GLState::ForgetFramebuffer(GLuint id)
+{
+	if (fbo == id)
+		fbo = Unknown;
+}
+
+void GLState::Invalidate()
+{
+	program = vao = fbo = activeUnit = Unknown;
+	for (GLuint unit = 0; unit < MaxTextureUnits; unit++)
+		textures[unit][0] = textures[unit][1] = Unknown;
+	depthTest = depthMask = cullFace = -1;
+	depthFunc = Unknown;
+	viewportKnown = false;
+}
@@ -0,0 +1,82 @@
+#ifndef GL_STATE_CLASS_H
+#define GL_STATE_CLASS_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the renderer touches: program, VAO, 2D and cube map
+// textures per unit, draw framebuffer, depth test/mask/func, face culling and viewport.
+// Setters skip the GL call when the value is already current and never query the
+// driver, so everything that changes this state has to go through here. Values start
+// out unknown, the first set of each is always issued.
+class GLState
+{
+public:
+	static constexpr GLuint MaxTextureUnits = 16;
+
+	// Setter calls that reached GL and ones the cache absorbed
+	struct Counters
+	{
+		unsigned long long issued = 0;
+		unsigned long long skipped = 0;
+	};
+	static Counters counters;
+
+	// Each returns true if the GL call was issued
+	static bool UseProgram(GLuint program);
+	static bool BindVertexArray(GLuint vao);
+	static bool BindFramebuffer(GLuint fbo);
+	static bool ActiveTexture(GLuint unit);
+	// Selects unit first. Targets other than 2D and cube map are not tracked and always bind.
+	static bool BindTexture(GLuint unit, GLenum target, GLuint texture);
+	// Binds on the active unit, for uploads and parameter changes
+	static bool BindTexture(GLenum target, GLuint texture);
+
+	static bool SetDepthTest(bool enabled);
+	static bool SetDepthMask(bool enabled);
+	static bool SetDepthFunc(GLenum func);
+	static bool SetCullFace(bool enabled);
+	static bool Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Last viewport set through Viewport, false if there has been none
+	static bool GetViewport(GLint out[4]);
+	// Unknown counts as GL's default, disabled
+	static bool CullFaceEnabled() { return cullFace == 1; }
+
+	// GL unbinds deleted objects, so the cache must not keep their (reusable) names
+	static void ForgetProgram(GLuint program);
+	static void ForgetVertexArray(GLuint vao);
+	static void ForgetTexture(GLuint texture);
+	static void ForgetFramebuffer(GLuint fbo);
+
+	// Marks everything unknown, after code that changed GL state behind the cache
+	static void Invalidate();
+
+private:
+	static constexpr GLuint Unknown = ~0u;
+
+	static GLuint program;
+	static GLuint vao;
+	static GLuint fbo;
+	static GLuint activeUnit;
+	// [unit][0] is GL_TEXTURE_2D, [unit][1] GL_TEXTURE_CUBE_MAP
+	static GLuint textures[MaxTextureUnits][2];
+	// -1 unknown, 0 off, 1 on
+	static signed char depthTest;
+	static signed char depthMask;
+	static signed char cullFace;
+	static GLenum depthFunc;
+	static GLint viewport[4];
+	static bool viewportKnown;
+
+	static bool changed(bool differs)
+	{
+		if (differs)
+			counters.issued++;
+		else
+			counters.skipped++;
+		return differs;
+	}
+	static bool setCapability(signed char& cached, GLenum cap, bool enabled);
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "GeometryPool.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <iterator>
+
+// -------------------- FreeListAllocator --------------------
+FreeListAllocator::FreeListAllocator(size_t capacity)
+{
+	Grow(capacity);
+}
+
+size_t FreeListAllocator::Allocate(size_t size, size_t alignment)
+{
+	if (size == 0)
+		return 0;
+
+	for (auto it = blocks.begin(); it != blocks.end(); ++it)
+	{
+		size_t start = it->first, blockSize = it->second;
+		size_t aligned = (start + alignment - 1) / alignment * alignment;
+		if (aligned + size > start + blockSize)
+			continue;
+
+		// Keep whatever is left on either side
+		blocks.erase(it);
+		if (aligned > start)
+			blocks[start] = aligned - start;
+		if (aligned + size < start + blockSize)
+			blocks[aligned + size] = start + blockSize - aligned - size;
+
+		used += size;
+		return aligned;
+	}
+	return None;
+}
+
+void FreeListAllocator::Free(size_t offset, size_t size)
+{
+	if (size == 0)
+		return;
+	used -= std::min(used, size);
+
+	auto next = blocks.lower_bound(offset);
+	if (next != blocks.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = blocks.erase(next);
+	}
+	if (next != blocks.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+	blocks[offset] = size;
+}
+
+void FreeListAllocator::Grow(size_t newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+	size_t oldCapacity = capacity;
+	capacity = newCapacity;
+	// Free() would count the new space as released
+	size_t usedBefore = used;
+	Free(oldCapacity, newCapacity - oldCapacity);
+	used = usedBefore;
+}
+
+// -------------------- GeometryPool --------------------
+GeometryPool::GeometryPool(VertexFormat format)
+	: format(format), stride(format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex))
+{
+}
+
+GeometryPool& GeometryPool::Shared(VertexFormat format)
+{
+	static GeometryPool floatPool(VertexFormat::Float);
+	static GeometryPool packedPool(VertexFormat::Packed);
+	return format == VertexFormat::Packed ? packedPool : floatPool;
+}
+
+void GeometryPool::resize(GLuint& buffer, size_t oldBytes, size_t newBytes)
+{
+	GLuint larger;
+	glGenBuffers(1, &larger);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+	if (buffer)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = larger;
+}
+
+void GeometryPool::growVertices(size_t needed)
+{
+	size_t capacity = std::max(InitialVertices, vertexSpace.Capacity() * 2);
+	while (capacity < vertexSpace.Capacity() + needed)
+		capacity *= 2;
+
+	resize(vbo, vertexSpace.Capacity() * stride, capacity * stride);
+	vertexSpace.Grow(capacity);
+	bindAttributes();
+	growths++;
+}
+
+void GeometryPool::growIndices(size_t needed)
+{
+	size_t capacity = std::max(InitialIndexBytes, indexSpace.Capacity() * 2);
+	while (capacity < indexSpace.Capacity() + needed)
+		capacity *= 2;
+
+	resize(ebo, indexSpace.Capacity(), capacity);
+	indexSpace.Grow(capacity);
+	bindAttributes();
+	growths++;
+}
+
+void GeometryPool::bindAttributes()
+{
+	if (!vao)
+		glGenVertexArrays(1, &vao);
+
+	// The VAO keeps the buffer names it was pointed at, so a resize has to re-point it
+	GLState::BindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	if (vbo)
+		Mesh::SetVertexAttributes(format);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	Mesh::UnbindVertexArray();
+}
+
+GeometryPool::Block GeometryPool::Add(const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes)
+{
+	Allocation a;
+	size_t firstVertex = vertexSpace.Allocate(vertexCount);
+	if (firstVertex == FreeListAllocator::None)
+	{
+		growVertices(vertexCount);
+		firstVertex = vertexSpace.Allocate(vertexCount);
+	}
+
+	// 4-byte aligned so 32-bit index data can follow 16-bit data
+	size_t indexOffset = indexSpace.Allocate(indexBytes, sizeof(unsigned int));
+	if (indexOffset == FreeListAllocator::None)
+	{
+		growIndices(indexBytes + sizeof(unsigned int));
+		indexOffset = indexSpace.Allocate(indexBytes, sizeof(unsigned int));
+	}
+
+	a.firstVertex = (unsigned int)firstVertex;
+	a.vertexCount = (unsigned int)vertexCount;
+	a.indexOffset = indexOffset;
+	a.indexBytes = indexBytes;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * stride, vertexCount * stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	allocations++;
+	return Block(this, a);
+}
+
+void GeometryPool::Free(const Allocation& allocation)
+{
+	vertexSpace.Free(allocation.firstVertex, allocation.vertexCount);
+	indexSpace.Free(allocation.indexOffset, allocation.indexBytes);
+	allocations--;
+}
+
+GeometryPool::Stats GeometryPool::GetStats() const
+{
+	Stats stats;
+	stats.vertexCapacity = vertexSpace.Capacity();
+	stats.verticesUsed = vertexSpace.Used();
+	stats.indexCapacity = indexSpace.Capacity();
+	stats.indexBytesUsed = indexSpace.Used();
+	stats.allocations = allocations;
+	stats.growths = growths;
+	return stats;
+}
@@ -0,0 +1,126 @@
+#ifndef GEOMETRY_POOL_CLASS_H
+#define GEOMETRY_POOL_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <glad/glad.h>
+
+enum class VertexFormat;
+
+// First-fit free list over an abstract [0, capacity) range. Adjacent free blocks are
+// merged on Free(), so the list stays as short as the fragmentation allows.
+class FreeListAllocator
+{
+public:
+	static constexpr size_t None = SIZE_MAX;
+
+	explicit FreeListAllocator(size_t capacity = 0);
+
+	// Returns the offset of a block of size units aligned to alignment, or None
+	size_t Allocate(size_t size, size_t alignment = 1);
+	void Free(size_t offset, size_t size);
+	// Adds [Capacity(), capacity) to the free space
+	void Grow(size_t capacity);
+
+	size_t Capacity() const { return capacity; }
+	size_t Used() const { return used; }
+	size_t FreeBlocks() const { return blocks.size(); }
+
+private:
+	std::map<size_t, size_t> blocks;  // offset -> size of every free block
+	size_t capacity = 0;
+	size_t used = 0;
+};
+
+// One VAO, vertex buffer and index buffer shared by every Mesh of a vertex layout.
+// Meshes get a vertex range and an index byte range from free lists and draw with
+// glDrawElementsBaseVertex, so a whole Model draws without switching VAOs.
+// Buffers double (GPU side copy) when an allocation does not fit. GL thread only.
+class GeometryPool
+{
+public:
+	struct Allocation
+	{
+		unsigned int firstVertex = 0;
+		unsigned int vertexCount = 0;
+		size_t indexOffset = 0;     // bytes into the index buffer
+		size_t indexBytes = 0;
+	};
+
+	struct Stats
+	{
+		size_t vertexCapacity = 0;  // vertices
+		size_t verticesUsed = 0;
+		size_t indexCapacity = 0;   // bytes, 16 and 32-bit indices share the buffer
+		size_t indexBytesUsed = 0;
+		size_t allocations = 0;
+		size_t growths = 0;
+	};
+
+	// Move-only ownership of an Allocation, returned to the pool on destruction
+	class Block
+	{
+	public:
+		Block() = default;
+		Block(GeometryPool* pool, const Allocation& allocation) : pool(pool), allocation(allocation) {}
+		~Block() { if (pool) pool->Free(allocation); }
+		Block(const Block&) = delete;
+		Block& operator=(const Block&) = delete;
+		Block(Block&& other) noexcept : pool(other.pool), allocation(other.allocation) { other.pool = nullptr; }
+		Block& operator=(Block&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (pool)
+					pool->Free(allocation);
+				pool = other.pool;
+				allocation = other.allocation;
+				other.pool = nullptr;
+			}
+			return *this;
+		}
+
+		explicit operator bool() const { return pool != nullptr; }
+		GeometryPool* Pool() const { return pool; }
+		const Allocation& Get() const { return allocation; }
+
+	private:
+		GeometryPool* pool = nullptr;
+		Allocation allocation;
+	};
+
+	explicit GeometryPool(VertexFormat format);
+	// The context is gone by the time the shared pools are destroyed, buffers are not deleted
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	// Copies vertexCount vertices of the pool's layout and indexBytes of index data in
+	Block Add(const void* vertices, size_t vertexCount, const void* indices, size_t indexBytes);
+	void Free(const Allocation& allocation);
+
+	GLuint VAO() const { return vao; }
+	Stats GetStats() const;
+
+	static GeometryPool& Shared(VertexFormat format);
+
+private:
+	static constexpr size_t InitialVertices = 1 << 16;
+	static constexpr size_t InitialIndexBytes = 1 << 18;
+
+	VertexFormat format;
+	size_t stride;
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	FreeListAllocator vertexSpace;
+	FreeListAllocator indexSpace;
+	size_t allocations = 0;
+	size_t growths = 0;
+
+	// Replaces buffer with a larger copy of itself
+	static void resize(GLuint& buffer, size_t oldBytes, size_t newBytes);
+	void growVertices(size_t needed);
+	void growIndices(size_t needed);
+	void bindAttributes();
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+	glGenQueries(Latency, queries);
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(Latency, queries);
+}
+
+void GpuTimer::Begin()
+{
+	// The query in this slot was issued Latency frames ago, it is normally done by now
+	collect(slot);
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void GpuTimer::End()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[slot] = true;
+	slot = (slot + 1) % Latency;
+}
+
+bool GpuTimer::Average(double& ms)
+{
+	if (samples == 0)
+		return false;
+
+	ms = sumMs / samples;
+	sumMs = 0.0;
+	samples = 0;
+	return true;
+}
+
+void GpuTimer::collect(int index)
+{
+	if (!pending[index])
+		return;
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+	pending[index] = false;
+
+	sumMs += elapsed / 1.0e6;
+	samples++;
+}
@@ -0,0 +1,33 @@
+#ifndef GPU_TIMER_CLASS_H
+#define GPU_TIMER_CLASS_H
+
+#include <glad/glad.h>
+
+// GL_TIME_ELAPSED timer for one block of GPU work per frame.
+// Results are read back a few frames late so the query never stalls the pipeline.
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	void Begin();
+	void End();
+
+	// Average GPU time of the samples gathered since the last call, false if there were none
+	bool Average(double& ms);
+
+private:
+	static const int Latency = 4;
+	GLuint queries[Latency] = {};
+	bool pending[Latency] = {};
+	int slot = 0;
+	double sumMs = 0.0;
+	int samples = 0;
+
+	void collect(int index);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "Shader.h"
 #include "HDRTexture.h"
 #include "Cubemap.h"
+#include "GLState.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 HDRConverter::HDRConverter(int cubemapSize) : size(cubemapSize) {
@@ -12,14 +13,14 @@ HDRConverter::HDRConverter(int cubemapSize) : size(cubemapSize) {
 
 HDRConverter::~HDRConverter() {
 	if (shader) delete shader;
-	if (fbo) glDeleteFramebuffers(1, &fbo);
+	if (fbo) { GLState::ForgetFramebuffer(fbo); glDeleteFramebuffers(1, &fbo); }
 	if (rbo) glDeleteRenderbuffers(1, &rbo);
 }
 
 void HDRConverter::initFramebuffer() {
 	// Create framebuffer
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::BindFramebuffer(fbo);
 	// Create renderbuffer for depth testing
 	glGenRenderbuffers(1, &rbo);
 	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
@@ -27,7 +28,7 @@ void HDRConverter::initFramebuffer() {
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
 	// Unbind
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::BindFramebuffer(0);
 }
 
 void HDRConverter::initMatrices() {
@@ -74,7 +75,7 @@ static void renderCube() {
 		glGenVertexArrays(1, &cubeVAO);
 		glGenBuffers(1, &cubeVBO);
 
-		glBindVertexArray(cubeVAO);
+		GLState::BindVertexArray(cubeVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
@@ -83,20 +84,19 @@ static void renderCube() {
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	}
 
-	glBindVertexArray(cubeVAO);
+	GLState::BindVertexArray(cubeVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
 }
 
 void HDRConverter::convert(const HDRTexture& src, Cubemap& dst) {
-	// Render into cubemap resolution
+	// Render into cubemap resolution, previous state comes from the cache instead of glGet
 	GLint prevViewport[4];
-	glGetIntegerv(GL_VIEWPORT, prevViewport);
-	glViewport(0, 0, size, size);
+	bool restoreViewport = GLState::GetViewport(prevViewport);
+	GLState::Viewport(0, 0, size, size);
 	// Bind framebuffer to render offscreen
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	GLboolean wasCulling = glIsEnabled(GL_CULL_FACE);
-	glDisable(GL_CULL_FACE);
+	GLState::BindFramebuffer(fbo);
+	bool wasCulling = GLState::CullFaceEnabled();
+	GLState::SetCullFace(false);
 	// Bind shader and set uniforms
 	shader->Activate();
 	shader->setInt("eqrMap", 0);
@@ -108,19 +108,19 @@ void HDRConverter::convert(const HDRTexture& src, Cubemap& dst) {
 		// Set view matrix for current face
 		shader->setMat4("view", views[i]);
 		// Attach the corresponding cubemap face as the render target
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, dst.ID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, dst.ID.get(), 0);
 		// Clear previous contents
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Render cube: each fragment computes a direction vector
 		renderCube();
 	}
 	// Restore default framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	if (wasCulling) glEnable(GL_CULL_FACE);
-	else glDisable(GL_CULL_FACE);
+	GLState::BindFramebuffer(0);
+	GLState::SetCullFace(wasCulling);
 	// Generate mipmaps for smoother reflections/refractions
-	glBindTexture(GL_TEXTURE_CUBE_MAP, dst.ID);
+	GLState::BindTexture(GL_TEXTURE_CUBE_MAP, dst.ID.get());
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 	// Restore previous state
-	glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+	if (restoreViewport)
+		GLState::Viewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
 }
\ No newline at end of file
@@ -1,46 +1,25 @@
 #include "HDRTexture.h"
 #include <iostream>
-#include <stb/stb_image.h>
+#include "TextureStreamer.h"
 #include <filesystem>
 
 
 HDRTexture::HDRTexture(const std::string& path) {
-	// Load the HDR image data from file
 	std::cout << "[HDRTexture] trying path: " << path << "\n";
 	std::cout << "[HDRTexture] cwd: " << std::filesystem::current_path().string() << "\n";
-	// Flips the image so it appears right side up
-	int width, height, channels;
-	stbi_set_flip_vertically_on_load(true);
-	float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 0);
-	if (!data) {
-		std::cerr << "Failed to load HDR texture: " << path << std::endl;
-		std::cerr << "stbi reason: " << stbi_failure_reason() << "\n";
-		ID = 0;
-		return;
-	}
 
-	
-	// Generates an OpenGL texture object
-	glGenTextures(1, &ID);
-	glBindTexture(GL_TEXTURE_2D, ID);
-
-	// Configures the type of algorithm that is used to make the image smaller or bigger
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Configures the way the texture repeats
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	// Upload the HDR image data to the texture
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
-
-	// Free the image data
-	stbi_image_free(data);
-	std::cout << "[HDRTexture] Loaded " << path << "\n";
+	// Float RGB, no mips, clamped. Decoded on a worker and streamed in by TextureStreamer,
+	// a 1x1 placeholder is bound until then
+	TextureStreamer::Format format;
+	format.internalFormat = GL_RGB16F;
+	format.format = GL_RGB;
+	format.channels = 3;
+	format.hdr = true;
+	format.mipmaps = false;
+	format.wrap = GL_CLAMP_TO_EDGE;
+	ID = TextureStreamer::Shared().Load(path, format);
 }
 
 void HDRTexture::Bind(GLuint unit) const {
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, ID);
+    GLState::BindTexture(unit, GL_TEXTURE_2D, ID.get());
 }
\ No newline at end of file
@@ -3,10 +3,12 @@
 #include <string>
 #include <glad/glad.h>
 
+#include "TextureStreamer.h"
+
 // Loads an HDR equirectangular texture from disk
 class HDRTexture{
 public:
-    GLuint ID;
+    StreamedTexture ID;
     int width = 0;
     int height = 0;
 
@@ -0,0 +1,43 @@
+#ifndef INSTANCE_BUFFER_CLASS_H
+#define INSTANCE_BUFFER_CLASS_H
+
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLHandle.h"
+
+// Per-instance vertex data read by the INSTANCED variant of vertex.glsl
+struct InstanceData
+{
+	glm::mat4 model;
+	unsigned int material;  // picks the absorption tint in fragment.glsl, below MaxMaterials
+};
+
+// Vertex buffer of InstanceData with a divisor of 1. Mesh::DrawInstanced points the VAO it
+// draws from at it (attributes 3-7), the same way DrawBatch re-points shared pool VAOs at its
+// records. Upload orphans and refills the storage, the buffer name never changes.
+class InstanceBuffer
+{
+public:
+	// First attribute location used, the matrix takes four
+	static constexpr GLuint FirstLocation = 3;
+	// Length of the instanceTints array in fragment.glsl
+	static constexpr unsigned int MaxMaterials = 4;
+
+	void Create(size_t capacity = 1);
+	void Upload(const InstanceData* instances, size_t count);
+
+	GLuint ID() const { return buffer.get(); }
+	size_t Count() const { return count; }
+
+	// Attribute pointers 3-7 for the buffer bound to GL_ARRAY_BUFFER, into the bound VAO
+	static void SetAttributes();
+
+private:
+	BufferHandle buffer;
+	size_t capacity = 0;
+	size_t count = 0;
+};
+
+#endif
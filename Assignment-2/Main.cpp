@@ -1,52 +1,257 @@
 ﻿#include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <random>
 
 #include "shaderClass.h"
 #include "Camera.h"
+#include "DrawBatch.h"
+#include "FrustumCuller.h"
 #include "Model.h"
-#include "stb_image.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "AssetRegistry.h"
+#include "GLState.h"
+#include "GpuTimer.h"
+#include "InstanceBuffer.h"
+#include "SceneGraph.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
 
 // -------------------- Window --------------------
 constexpr unsigned int SCR_WIDTH = 1280;
 constexpr unsigned int SCR_HEIGHT = 720;
 
+// -------------------- Models --------------------
+// Drop Model::PackVertices to compare against the 32-byte float layout,
+// Model::MergeGeometry to compare per-mesh VAOs against the shared GeometryPool
+constexpr unsigned int MODEL_OPTIONS = Model::OptimizeMeshes | Model::PackVertices | Model::GenerateLods |
+    Model::BuildMeshlets | Model::MergeGeometry;
+constexpr int BENCH_REPORT_FRAMES = 240;
+// CPU time per frame TextureStreamer may spend on uploads
+constexpr double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+// false decodes with stb and builds mips with glGenerateMipmap, to compare against the cooked path.
+// The first cooked run writes the .texcook files, later runs load them.
+constexpr bool TEXTURE_COOK = true;
+// Size of the start-up SceneGraph benchmark, 0 skips it
+constexpr int SCENE_BENCH_NODES = 100000;
+// Largest object count of the start-up DrawBatch benchmark (10, 100, ...), 0 skips it.
+// Per-object Model::Draw is only timed up to DRAW_BENCH_PER_OBJECT_MAX.
+constexpr int DRAW_BENCH_MAX = 100000;
+constexpr int DRAW_BENCH_PER_OBJECT_MAX = 10000;
+// Object count of the start-up frustum culling benchmark, 0 skips it
+constexpr int CULL_BENCH_OBJECTS = 100000;
+// TeapotToBe copies on a ring around the scene, one instanced draw per mesh, 0 skips them
+constexpr int INSTANCED_TEAPOTS = 64;
+// Draws the frustum-culled objects through OcclusionCuller, false draws all of them directly
+constexpr bool OCCLUSION_CULLING = true;
+
 // -------------------- Callbacks -----------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    GLState::Viewport(0, 0, width, height);
 }
 
 // -------------------- HDR Loader ----------------
-unsigned int loadHDR(const char* path)
+StreamedTexture loadHDR(const char* path)
+{
+    // Streamed in the background, the sky shows a 1x1 placeholder until then
+    TextureStreamer::Format format;
+    format.internalFormat = GL_RGB16F;
+    format.format = GL_RGB;
+    format.channels = 3;
+    format.hdr = true;
+    format.mipmaps = false;
+    format.wrap = GL_CLAMP_TO_EDGE;
+    return TextureStreamer::Shared().Load(path, format);
+}
+
+// -------------------- Scene Benchmark -----------
+// Random hierarchy of SCENE_BENCH_NODES spinning nodes, one frame's transforms three ways: the
+// translate/rotate/scale chain the render loop used to build for every object, SetLocal +
+// Update with every node animated, and the same with only 1% of the nodes animated
+void benchmarkSceneGraph()
 {
-    stbi_set_flip_vertically_on_load(true);
+    if (SCENE_BENCH_NODES <= 0)
+        return;
 
-    int w, h, n;
-    float* data = stbi_loadf(path, &w, &h, &n, 0);
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
 
-    if (!data)
+    struct Spin
     {
-        std::cout << "FAILED TO LOAD HDR: " << path << std::endl;
-        return 0;
+        glm::vec3 offset;
+        float speed;
+        float scale;
+    };
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Spin> spins(SCENE_BENCH_NODES);
+    for (Spin& spin : spins)
+        spin = Spin{ glm::vec3(unit(rng) * 10.0f - 5.0f, 0.0f, 0.0f), 0.2f + unit(rng), 0.5f + unit(rng) };
+
+    const glm::vec3 axis(0, 1, 0);
+    float time = 1.0f;
+    SceneGraph scene;
+    scene.Reserve(SCENE_BENCH_NODES);
+    for (int i = 0; i < SCENE_BENCH_NODES; i++)
+    {
+        // 8-ary tree in breadth-first order, about six levels deep
+        int parent = i == 0 ? SceneGraph::None : (i - 1) / 8;
+        scene.AddNode(parent);
     }
+    scene.Update();
 
-    unsigned int tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    glTexImage2D(
-        GL_TEXTURE_2D, 0, GL_RGB16F,
-        w, h, 0, GL_RGB, GL_FLOAT, data
-    );
+    // As the render loop did before SceneGraph: the whole chain per object, every frame
+    std::vector<glm::mat4> chained(SCENE_BENCH_NODES);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SCENE_BENCH_NODES; i++)
+    {
+        const Spin& spin = spins[i];
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, spin.offset);
+        model = glm::rotate(model, time * spin.speed, axis);
+        model = glm::scale(model, glm::vec3(spin.scale));
+        int parent = scene.Parent(i);
+        chained[i] = parent == SceneGraph::None ? model : chained[parent] * model;
+    }
+    double chainMs = msSince(start);
+
+    auto spinLocal = [&](int node) {
+        const Spin& spin = spins[node];
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), spin.offset);
+        return glm::scale(glm::rotate(local, time * spin.speed, axis), glm::vec3(spin.scale));
+    };
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SCENE_BENCH_NODES; i++)
+        scene.SetLocal(i, spinLocal(i));
+    size_t fullNodes = scene.Update();
+    double fullMs = msSince(start);
+
+    time += 0.016f;
+    std::vector<int> animated(SCENE_BENCH_NODES / 100);
+    for (int& node : animated)
+        node = (int)(rng() % SCENE_BENCH_NODES);
+    start = std::chrono::steady_clock::now();
+    for (int node : animated)
+        scene.SetLocal(node, spinLocal(node));
+    size_t partialNodes = scene.Update();
+    double partialMs = msSince(start);
+
+    std::cout << "[SceneGraph] " << SCENE_BENCH_NODES << " nodes: per-frame glm chain " << chainMs
+        << " ms, all animated " << fullMs << " ms (" << fullNodes << " nodes), 1% animated " << partialMs
+        << " ms (" << partialNodes << " nodes)\n";
+}
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// -------------------- Draw Benchmark ------------
+// DRAW_BENCH_MAX objects at most, cycling through models: CPU submission time of one
+// Model::Draw per object against a DrawBatch, with multi-draw and with the base-vertex
+// fallback. Submission is timed before the glFinish.
+void benchmarkDrawBatch(const Model* const* models, size_t modelCount, Shader& objectShader, Shader& batchShader, const Camera& camera)
+{
+    if (DRAW_BENCH_MAX <= 0)
+        return;
+
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> spread(-20.0f, 20.0f);
+    std::vector<glm::mat4> placements(DRAW_BENCH_MAX);
+    for (glm::mat4& placement : placements)
+        placement = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(spread(rng), spread(rng), -25.0f + spread(rng))), glm::vec3(0.1f));
+
+    DrawBatch batch;
+    auto timeBatch = [&](int count, bool multiDraw, size_t& submits) {
+        DrawBatch::SetMultiDraw(multiDraw);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        batch.Clear();
+        for (int i = 0; i < count; i++)
+            models[i % modelCount]->Submit(batch, placements[i]);
+        batch.Draw(batchShader);
+        double ms = msSince(start);
+        glFinish();
+        submits = batch.GetStats().submits;
+        return ms;
+    };
+
+    for (int count = 10; count <= DRAW_BENCH_MAX; count *= 10)
+    {
+        std::cout << "[DrawBatch] " << count << " objects:";
+        if (count <= DRAW_BENCH_PER_OBJECT_MAX)
+        {
+            glFinish();
+            auto start = std::chrono::steady_clock::now();
+            objectShader.Activate();
+            for (int i = 0; i < count; i++)
+                models[i % modelCount]->Draw(objectShader, camera, placements[i]);
+            std::cout << " per-object Draw " << msSince(start) << " ms,";
+            glFinish();
+        }
+
+        size_t submits = 0;
+        if (DrawBatch::MultiDrawAvailable())
+        {
+            double ms = timeBatch(count, true, submits);
+            std::cout << " multi-draw " << ms << " ms (" << submits << " calls),";
+        }
+        double ms = timeBatch(count, false, submits);
+        std::cout << " fallback " << ms << " ms (" << submits << " calls), "
+            << batch.GetStats().buckets << " buckets\n";
+    }
+    DrawBatch::SetMultiDraw(true);
+    Mesh::UnbindVertexArray();
+}
 
-    stbi_image_free(data);
-    return tex;
+// -------------------- Culling Benchmark ---------
+// CULL_BENCH_OBJECTS objects scattered all around the camera: world bounds for all of them,
+// then the SIMD and the scalar culling pass over the same data
+void benchmarkFrustumCulling(const Model* const* models, size_t modelCount, const Camera& camera)
+{
+    if (CULL_BENCH_OBJECTS <= 0)
+        return;
+
+    auto msSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    std::vector<glm::mat4> worlds(CULL_BENCH_OBJECTS);
+    for (glm::mat4& world : worlds)
+        world = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(spread(rng), spread(rng), spread(rng))),
+            angle(rng), glm::vec3(0, 1, 0));
+
+    FrustumCuller culler;
+    culler.Reserve(CULL_BENCH_OBJECTS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CULL_BENCH_OBJECTS; i++)
+        culler.Add(models[i % modelCount]->bounds, worlds[i]);
+    double boundsMs = msSince(start);
+
+    MeshletBuilder::Frustum frustum = MeshletBuilder::ObjectFrustum(camera.cameraMatrix, camera.Position);
+    start = std::chrono::steady_clock::now();
+    culler.CullScalar(frustum);
+    double scalarMs = msSince(start);
+    std::vector<uint32_t> scalarVisible = culler.VisibleObjects();
+
+    start = std::chrono::steady_clock::now();
+    culler.Cull(frustum);
+    double simdMs = msSince(start);
+
+    const FrustumCuller::Stats& stats = culler.GetStats();
+    std::cout << "[FrustumCuller] " << stats.tested << " objects: world bounds " << boundsMs << " ms, cull "
+        << simdMs << " ms SIMD / " << scalarMs << " ms scalar, " << stats.visible << " visible, "
+        << stats.culled << " culled" << (scalarVisible == culler.VisibleObjects() ? "" : " (SIMD MISMATCH)") << "\n";
 }
 
 float skyboxVertices[] = {
@@ -73,6 +278,7 @@ float skyboxVertices[] = {
 // -------------------- Main ----------------------
 int main()
 {
+    auto launch = std::chrono::steady_clock::now();
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -98,17 +304,20 @@ int main()
         std::cout << "Failed to init GLAD\n";
         return -1;
     }
+    DrawBatch::LoadMultiDraw((GLADloadproc)glfwGetProcAddress);
 
-    glEnable(GL_DEPTH_TEST);
+    // All state changes go through GLState from here on, it never reads GL back
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    GLState::Viewport(0, 0, framebufferWidth, framebufferHeight);
+    GLState::SetDepthTest(true);
 
     // ---------- SKYBOX SETUP (CORRECT PLACE) ----------
-    unsigned int skyVAO, skyVBO;
-
-    glGenVertexArrays(1, &skyVAO);
-    glGenBuffers(1, &skyVBO);
+    VertexArrayHandle skyVAO = GenVertexArray();
+    BufferHandle skyVBO = GenBuffer();
 
-    glBindVertexArray(skyVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyVBO);
+    GLState::BindVertexArray(skyVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, skyVBO.get());
     glBufferData(GL_ARRAY_BUFFER,
         sizeof(skyboxVertices),
         skyboxVertices,
@@ -121,7 +330,7 @@ int main()
         (void*)0
     );
 
-    glBindVertexArray(0);
+    GLState::BindVertexArray(0);
 
     // Camera MUST use this constructor
     Camera camera(SCR_WIDTH, SCR_HEIGHT, glm::vec3(0.0f, 0.0f, 6.0f));
@@ -131,27 +340,124 @@ int main()
     skyShader.setInt("hdrMap", 0);
 
     Shader glassShader("vertex.glsl", "fragment.glsl");
-    Model glassModel1("Models/TeapotToBe.obj");   // OBJ, no textures
-    Model glassModel2("Models/Bottle.obj");   // OBJ, no textures
-    Model glassModel3("Models/Sphere.obj");   // OBJ, no textures
+    // Shared through the registry, repeated paths reuse one upload
+    AssetRegistry& assets = AssetRegistry::Shared();
+    TextureCache::Shared().SetCooking(TEXTURE_COOK);
+    std::shared_ptr<const Model> glassModel1 = assets.LoadModel("Models/TeapotToBe.glb", MODEL_OPTIONS);   // GLB, no textures
+    std::shared_ptr<const Model> glassModel2 = assets.LoadModel("Models/Bottle.glb", MODEL_OPTIONS);   // GLB, embedded base color PNG
+    std::shared_ptr<const Model> glassModel3 = assets.LoadModel("Models/Sphere.obj", MODEL_OPTIONS);   // OBJ, no textures
+    std::cout << "[AssetRegistry] " << assets.GetStats().loads << " loads, " << assets.GetStats().loadsAvoided
+        << " avoided, " << assets.GetStats().bytesSaved << " bytes saved\n";
+    if (MODEL_OPTIONS & Model::MergeGeometry)
+    {
+        GeometryPool::Stats pool = GeometryPool::Shared((MODEL_OPTIONS & Model::PackVertices) ? VertexFormat::Packed : VertexFormat::Float).GetStats();
+        std::cout << "[GeometryPool] " << pool.allocations << " meshes, " << pool.verticesUsed << "/" << pool.vertexCapacity
+            << " vertices, " << pool.indexBytesUsed << "/" << pool.indexCapacity << " index bytes, "
+            << pool.growths << " growths\n";
+    }
 
-    unsigned int hdrTex = loadHDR("Models/Outside.hdr");
+    StreamedTexture hdrTex = loadHDR("Models/Outside.hdr");
 
     glassShader.Activate();
     glassShader.setInt("hdrMap", 0);
 
+    benchmarkSceneGraph();
+
+    // Glass shader taking its transform and tint from InstanceBuffer
+    Shader instancedGlassShader("vertex.glsl", "fragment.glsl", "#define INSTANCED\n");
+    instancedGlassShader.Activate();
+    instancedGlassShader.setInt("hdrMap", 0);
+    const glm::vec3 instanceTints[InstanceBuffer::MaxMaterials] = {
+        { 0.95f, 0.98f, 1.0f }, { 0.8f, 1.0f, 0.85f }, { 1.0f, 0.85f, 0.75f }, { 0.8f, 0.85f, 1.0f },
+    };
+    for (unsigned int i = 0; i < InstanceBuffer::MaxMaterials; i++)
+        instancedGlassShader.setVec3("instanceTints[" + std::to_string(i) + "]", instanceTints[i]);
+
+    // Glass shader reading per-draw records, for DrawBatch
+    Shader batchShader("vertex.glsl", "fragment.glsl", "#define DRAW_DATA\n");
+    {
+        camera.updateMatrix(45.0f, 0.1f, 100.0f);
+        for (Shader* shader : { &glassShader, &batchShader })
+        {
+            shader->Activate();
+            shader->setInt("hdrMap", 0);
+            camera.Matrix(*shader, "camMatrix");
+            shader->setVec3("cameraPos", camera.Position);
+        }
+        GLState::BindTexture(0, GL_TEXTURE_2D, hdrTex.get());
+        const Model* benchModels[] = { glassModel1.get(), glassModel2.get(), glassModel3.get() };
+        benchmarkDrawBatch(benchModels, 3, glassShader, batchShader, camera);
+        benchmarkFrustumCulling(benchModels, 3, camera);
+    }
+
+    // Each object is a fixed stand with a spinning child, only the spins change per frame
+    SceneGraph scene;
+    int teapotSpin = scene.AddNode(scene.AddNode(SceneGraph::None, glm::translate(glm::mat4(1.0f), glm::vec3(-5.0f, 0.0f, 0.0f))));
+    int bottleSpin = scene.AddNode(scene.AddNode(SceneGraph::None, glm::mat4(1.0f)));
+    int sphereSpin = scene.AddNode(scene.AddNode(SceneGraph::None, glm::translate(glm::mat4(1.0f), glm::vec3(5.0f, 0.0f, 0.0f))));
+
+    struct SceneObject {
+        const Model* model;
+        int node;
+    };
+    const SceneObject objects[] = {
+        { glassModel1.get(), teapotSpin },
+        { glassModel2.get(), bottleSpin },
+        { glassModel3.get(), sphereSpin },
+    };
+    const size_t objectCount = sizeof(objects) / sizeof(objects[0]);
+    FrustumCuller culler;
+    // Owns GL objects, reset before the context goes
+    std::unique_ptr<OcclusionCuller> occlusion = std::make_unique<OcclusionCuller>();
+    std::vector<Bounds> objectBounds;
+    for (const SceneObject& object : objects)
+        objectBounds.push_back(object.model->bounds);
+    std::vector<glm::mat4> objectWorlds(objectCount);
+    // Glass goes in the transparent layer, drawn back to front
+    RenderQueue glassQueue;
+    glassQueue.Reserve(objectCount);
+    std::vector<uint32_t> glassOrder;
+
+    // Owns a GL buffer, reset before the context goes
+    std::unique_ptr<InstanceBuffer> teapotInstances = std::make_unique<InstanceBuffer>();
+    teapotInstances->Create(std::max(INSTANCED_TEAPOTS, 1));
+    std::vector<InstanceData> teapotData(INSTANCED_TEAPOTS);
+
+    std::unique_ptr<GpuTimer> objectTimer = std::make_unique<GpuTimer>();
+    int frameCount = 0;
+    bool texturesResident = false;
+
     // --------------- RENDER LOOP ---------------
     while (!glfwWindowShouldClose(window))
     {
+        GLState::counters = GLState::Counters();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // 0. STREAM IN DECODED TEXTURES
+        TextureStreamer& streamer = TextureStreamer::Shared();
+        streamer.Update(TEXTURE_UPLOAD_BUDGET_MS);
+        if (!texturesResident && streamer.Idle())
+        {
+            texturesResident = true;
+            const TextureStreamer::Stats& s = streamer.GetStats();
+            std::cout << "[TextureStreamer] " << s.uploaded << " textures (" << s.bytesUploaded << " bytes) resident "
+                << glfwGetTime() * 1000.0 << " ms after init, frame " << frameCount
+                << ", worst upload frame " << s.worstFrameMs << " ms\n";
+            std::cout << "[TextureStreamer] " << (TEXTURE_COOK ? "cooked" : "stb") << " path: " << s.workerMs
+                << " ms decode on workers, " << s.cookHits << " cook hits, " << s.cooksWritten << " cooked\n";
+
+            TextureCache::Stats texStats = TextureCache::Shared().GetStats();
+            std::cout << "[TextureCache] " << texStats.hits << " hits, " << texStats.misses << " misses, "
+                << TextureCache::Shared().LiveTextures() << " live, " << texStats.bytesSaved << " bytes saved\n";
+        }
+
         // 1. UPDATE CAMERA FIRST
         camera.Inputs(window);
         camera.updateMatrix(45.0f, 0.1f, 100.0f);
 
         // 2. DRAW SKYBOX
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
+        GLState::SetDepthMask(false);
+        GLState::SetDepthFunc(GL_LEQUAL);
 
         skyShader.Activate();
 
@@ -163,51 +469,126 @@ int main()
 
         skyShader.setMat4("vp", vp);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, hdrTex);
+        GLState::BindTexture(0, GL_TEXTURE_2D, hdrTex.get());
 
-        glBindVertexArray(skyVAO);
+        GLState::BindVertexArray(skyVAO.get());
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
 
-        glDepthFunc(GL_LESS);
-        glDepthMask(GL_TRUE);
+        GLState::SetDepthFunc(GL_LESS);
+        GLState::SetDepthMask(true);
 
         // 3. DRAWING OBJECTS
+        size_t drawnTriangles = 0, culledTriangles = 0;
+        Mesh::counters = Mesh::DrawCounters();
+        objectTimer->Begin();
         glassShader.Activate();
         camera.Matrix(glassShader, "camMatrix");
         glassShader.setVec3("cameraPos", camera.Position);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, hdrTex);
-
-        // -------- TEAPOT --------
-        glm::mat4 model1 = glm::mat4(1.0f);
-        model1 = glm::translate(model1, glm::vec3(-5.0f, 0.0f, 0.0f));
-        model1 = glm::rotate(model1, (float)glfwGetTime() * 0.6f, glm::vec3(0, 1, 0));
-		model1 = glm::scale(model1, glm::vec3(0.9f));
-        glassShader.setMat4("model", model1);
-        glassModel1.Draw(glassShader);
-
-        // -------- BOTTLE --------
-        glm::mat4 model2 = glm::mat4(1.0f);
-        model2 = glm::translate(model2, glm::vec3(0.0f, 0.0f, 0.0f));
-        model2 = glm::rotate(model2, (float)glfwGetTime() * 0.4f, glm::vec3(0, 1, 0));
-        model2 = glm::scale(model2, glm::vec3(0.15f));
-        glassShader.setMat4("model", model2);
-        glassModel2.Draw(glassShader);
-
-        // -------- SPHERE --------
-        glm::mat4 model3 = glm::mat4(1.0f);
-        model3 = glm::translate(model3, glm::vec3(5.0f, 0.0f, 0.0f));
-        model3 = glm::rotate(model3, (float)glfwGetTime() * 0.4f, glm::vec3(0, 1, 0));
-		model3 = glm::scale(model3, glm::vec3(1.5f));
-        glassShader.setMat4("model", model3);
-        glassModel3.Draw(glassShader);
+        // Already bound for the sky, the cache drops the call
+        GLState::BindTexture(0, GL_TEXTURE_2D, hdrTex.get());
+
+        float time = (float)glfwGetTime();
+        scene.SetLocal(teapotSpin, glm::scale(glm::rotate(glm::mat4(1.0f), time * 0.6f, glm::vec3(0, 1, 0)), glm::vec3(0.9f)));
+        scene.SetLocal(bottleSpin, glm::scale(glm::rotate(glm::mat4(1.0f), time * 0.4f, glm::vec3(0, 1, 0)), glm::vec3(0.15f)));
+        scene.SetLocal(sphereSpin, glm::scale(glm::rotate(glm::mat4(1.0f), time * 0.4f, glm::vec3(0, 1, 0)), glm::vec3(1.5f)));
+        scene.Update();
+
+        // Teapot, bottle and sphere, only the ones inside the view frustum are drawn
+        culler.Clear();
+        for (size_t i = 0; i < objectCount; i++)
+        {
+            objectWorlds[i] = scene.World(objects[i].node);
+            culler.Add(objectBounds[i], objectWorlds[i]);
+        }
+        culler.Cull(MeshletBuilder::ObjectFrustum(camera.cameraMatrix, camera.Position));
+
+        glassQueue.Clear();
+        for (uint32_t i : culler.VisibleObjects())
+        {
+            float depth = glm::distance(camera.Position, glm::vec3(objectWorlds[i][3]));
+            glassQueue.Submit(RenderQueue::MakeKey(RenderQueue::Transparent, glassShader.ID, 0, depth), i);
+        }
+        glassQueue.Sort();
+        glassOrder.clear();
+        for (const RenderQueue::Packet& packet : glassQueue.Packets())
+            glassOrder.push_back(packet.item);
+
+        // Model::Draw sets "model" per mesh from these and the file's own node transforms.
+        // Counts include draws the GPU drops through occlusion queries. OcclusionCuller keeps
+        // the back to front order within each of its two phases.
+        auto drawObject = [&](uint32_t i) {
+            glassShader.Activate();
+            objects[i].model->Draw(glassShader, camera, objectWorlds[i]);
+            drawnTriangles += objects[i].model->drawnTriangles;
+            culledTriangles += objects[i].model->culledTriangles;
+        };
+        if (OCCLUSION_CULLING)
+            occlusion->Draw(glassOrder, objectBounds.data(), objectWorlds.data(),
+                camera.cameraMatrix, camera.Position, camera.nearPlane, drawObject);
+        else
+            for (uint32_t i : glassOrder)
+                drawObject(i);
+
+        // Ring of teapot copies, the same glass shading in one draw per mesh
+        if (INSTANCED_TEAPOTS > 0)
+        {
+            for (int i = 0; i < INSTANCED_TEAPOTS; i++)
+            {
+                float angle = 6.2831853f * i / INSTANCED_TEAPOTS;
+                glm::mat4 placement = glm::translate(glm::mat4(1.0f), glm::vec3(std::cos(angle) * 15.0f, -3.0f, std::sin(angle) * 15.0f));
+                teapotData[i].model = glm::scale(glm::rotate(placement, time * 0.6f + angle, glm::vec3(0, 1, 0)), glm::vec3(0.5f));
+                teapotData[i].material = (unsigned int)i % InstanceBuffer::MaxMaterials;
+            }
+            teapotInstances->Upload(teapotData.data(), teapotData.size());
+
+            instancedGlassShader.Activate();
+            camera.Matrix(instancedGlassShader, "camMatrix");
+            instancedGlassShader.setVec3("cameraPos", camera.Position);
+            glassModel1->DrawInstanced(instancedGlassShader, *teapotInstances);
+            drawnTriangles += glassModel1->drawnTriangles;
+        }
+        objectTimer->End();
+
+        double objectMs;
+        if (++frameCount % BENCH_REPORT_FRAMES == 0 && objectTimer->Average(objectMs))
+        {
+            std::cout << "[Bench] object pass " << objectMs << " ms GPU ("
+                << ((MODEL_OPTIONS & Model::PackVertices) ? "packed" : "float") << " vertices, "
+                << culler.GetStats().visible << "/" << culler.GetStats().tested << " objects in frustum, "
+                << occlusion->GetStats().drawnFromLastFrame << " drawn from last frame, "
+                << occlusion->GetStats().boxesTested << " box tested, "
+                << occlusion->GetStats().occluded << " occluded, "
+                << drawnTriangles << " tris drawn, "
+                << 100.0 * culledTriangles / std::max<size_t>(drawnTriangles + culledTriangles, 1)
+                << "% culled by meshlets, " << Mesh::counters.drawCalls << " draw calls, "
+                << Mesh::counters.vertexArrayBinds << " VAO binds, "
+                << GLState::counters.skipped << "/" << GLState::counters.issued + GLState::counters.skipped
+                << " redundant GL state calls skipped, "
+                << ((MODEL_OPTIONS & Model::MergeGeometry) ? "merged" : "per-mesh") << " buffers)\n";
+        }
 
         glfwSwapBuffers(window);
+        if (frameCount == 1)
+        {
+            std::cout << "[Startup] first frame presented " << std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - launch).count() << " ms after launch, "
+                << TextureStreamer::Shared().GetStats().uploaded << "/" << TextureStreamer::Shared().GetStats().queued
+                << " textures uploaded\n";
+        }
         glfwPollEvents();
     }
+
+    // GL objects go while the context is still alive
+    glassModel1.reset();
+    glassModel2.reset();
+    glassModel3.reset();
+    occlusion.reset();
+    teapotInstances.reset();
+    objectTimer.reset();
+    hdrTex.reset();
+    skyVBO.reset();
+    skyVAO.reset();
     glfwTerminate();
     return 0;
 }
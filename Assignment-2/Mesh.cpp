@@ -1,59 +1,381 @@
 ﻿#include "Mesh.h"
+#include "MeshletBuilder.h"
+#include "TextureCache.h"
 #include <glad/glad.h>
+#include <glm/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // Octahedral normal encoding, both components in [-1, 1]
+    glm::vec2 octEncode(glm::vec3 n)
+    {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.0f)
+            return glm::vec2(0.0f);
+
+        n /= l1;
+        glm::vec2 p(n.x, n.y);
+        if (n.z < 0.0f)
+        {
+            p = glm::vec2(
+                (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return p;
+    }
+}
+
+Mesh::DrawCounters Mesh::counters;
 
 Mesh::Mesh(std::vector<Vertex> verts,
     std::vector<unsigned int> inds,
-    std::vector<TextureInfo> tex)
+    std::vector<TextureInfo> tex,
+    VertexFormat fmt,
+    std::vector<MeshLod> lodTable,
+    std::vector<Meshlet> clusters,
+    GeometryPool* pool)
 {
+    format = fmt;
+    lods = std::move(lodTable);
+    meshlets = std::move(clusters);
     vertices = std::move(verts);
     indices = std::move(inds);
     textures = std::move(tex);
 
-    setupMesh();
+    setupMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), pool);
 }
 
-void Mesh::setupMesh()
+Mesh::Mesh(const Vertex* verts, size_t vertCount,
+    const unsigned int* inds, size_t indCount,
+    std::vector<TextureInfo> tex,
+    VertexFormat fmt,
+    std::vector<MeshLod> lodTable,
+    std::vector<Meshlet> clusters,
+    GeometryPool* pool)
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    format = fmt;
+    lods = std::move(lodTable);
+    meshlets = std::move(clusters);
+    textures = std::move(tex);
 
-    glBindVertexArray(VAO);
+    setupMesh(verts, vertCount, inds, indCount, pool);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+void Mesh::setupMesh(const Vertex* verts, size_t vertCount, const unsigned int* inds, size_t indCount, GeometryPool* pool)
+{
+    indexCount = (unsigned int)indCount;
+    if (lods.empty())
+        lods.push_back(MeshLod{ 0, indexCount, 0.0f });
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    // AABB and a sphere around its center, for culling and LOD selection
+    if (vertCount > 0)
+    {
+        glm::vec3 lo = verts[0].Position, hi = verts[0].Position;
+        for (size_t i = 1; i < vertCount; i++)
+        {
+            lo = glm::min(lo, verts[i].Position);
+            hi = glm::max(hi, verts[i].Position);
+        }
+        boundsMin = lo;
+        boundsMax = hi;
+        boundsCenter = (lo + hi) * 0.5f;
+        float r2 = 0.0f;
+        for (size_t i = 0; i < vertCount; i++)
+        {
+            glm::vec3 d = verts[i].Position - boundsCenter;
+            r2 = std::max(r2, glm::dot(d, d));
+        }
+        boundsRadius = std::sqrt(r2);
+    }
 
-    // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // Vertex data in the GPU layout
+    std::vector<PackedVertex> packed;
+    const void* vertexData = verts;
+    size_t vertexBytes = vertCount * sizeof(Vertex);
+    if (format == VertexFormat::Packed)
+    {
+        PackVertices(verts, vertCount, packed, posOffset, posScale);
+        vertexData = packed.data();
+        vertexBytes = packed.size() * sizeof(PackedVertex);
 
-    // Normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        std::cout << "[Mesh] packed " << vertCount << " verts: " << vertCount * sizeof(Vertex)
+            << " -> " << vertexBytes << " bytes\n";
+    }
 
-    // UV
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    std::vector<unsigned short> shortIndices(indCount);
+    bool fitsShort = true;
+    ranges.clear();
+    lodRangeStart.clear();
+    for (const MeshLod& lod : lods)
+    {
+        lodRangeStart.push_back((unsigned int)ranges.size());
+        if (!BuildShortRanges(inds + lod.firstIndex, lod.indexCount, shortIndices.data() + lod.firstIndex, lod.firstIndex, ranges))
+        {
+            fitsShort = false;
+            break;
+        }
+    }
 
-    glBindVertexArray(0);
+    const void* indexData;
+    size_t indexBytes;
+    if (fitsShort)
+    {
+        indexType = GL_UNSIGNED_SHORT;
+        indexData = shortIndices.data();
+        indexBytes = shortIndices.size() * sizeof(unsigned short);
+    }
+    else
+    {
+        // One 32-bit range per LOD
+        indexType = GL_UNSIGNED_INT;
+        ranges.clear();
+        lodRangeStart.clear();
+        for (const MeshLod& lod : lods)
+        {
+            lodRangeStart.push_back((unsigned int)ranges.size());
+            ranges.push_back(IndexRange{ lod.firstIndex, lod.indexCount, 0 });
+        }
+        indexData = inds;
+        indexBytes = indCount * sizeof(unsigned int);
+    }
+    lodRangeStart.push_back((unsigned int)ranges.size());
+    gpuBytes = vertexBytes + indexBytes;
+
+    if (pool)
+    {
+        pooled = pool->Add(vertexData, vertCount, indexData, indexBytes);
+        return;
+    }
+
+    VAO = GenVertexArray();
+    VBO = GenBuffer();
+    EBO = GenBuffer();
+
+    GLState::BindVertexArray(VAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+    SetVertexAttributes(format);
+
+    UnbindVertexArray();
+}
+
+void Mesh::SetVertexAttributes(VertexFormat fmt)
+{
+    if (fmt == VertexFormat::Packed)
+    {
+        // Position, unorm16 inside the mesh bounds
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+
+        // Normal, octahedral snorm16 in .xy
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+
+        // UV
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+    }
+    else
+    {
+        // Position
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+
+        // Normal
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+
+        // UV
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    }
 }
 
-void Mesh::Draw(Shader& shader)
+size_t Mesh::ReleaseCpuData()
 {
-    unsigned int unit = 0;
+    size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+    return bytes;
+}
+
+void Mesh::bindVertexArray() const
+{
+    if (GLState::BindVertexArray(vertexArray()))
+        counters.vertexArrayBinds++;
+}
+
+void Mesh::UnbindVertexArray()
+{
+    GLState::BindVertexArray(0);
+}
+
+bool Mesh::BuildShortRanges(const unsigned int* inds, size_t indCount,
+    unsigned short* dst, unsigned int firstIndex, std::vector<IndexRange>& out)
+{
+    const unsigned int maxSpan = 65535;
+
+    // Greedily grow a range while its vertex span still fits in 16 bits
+    size_t rangeStart = 0;
+    unsigned int lo = ~0u, hi = 0;
+    auto flush = [&](size_t end)
+        {
+            for (size_t i = rangeStart; i < end; i++)
+                dst[i] = (unsigned short)(inds[i] - lo);
+            out.push_back(IndexRange{ firstIndex + (unsigned int)rangeStart, (unsigned int)(end - rangeStart), (int)lo });
+        };
+
+    for (size_t t = 0; t + 2 < indCount; t += 3)
+    {
+        unsigned int triLo = std::min(inds[t], std::min(inds[t + 1], inds[t + 2]));
+        unsigned int triHi = std::max(inds[t], std::max(inds[t + 1], inds[t + 2]));
+        if (triHi - triLo > maxSpan)
+            return false;
+
+        unsigned int newLo = std::min(lo, triLo);
+        unsigned int newHi = std::max(hi, triHi);
+        if (t > rangeStart && newHi - newLo > maxSpan)
+        {
+            flush(t);
+            rangeStart = t;
+            newLo = triLo;
+            newHi = triHi;
+        }
+        lo = newLo;
+        hi = newHi;
+    }
+
+    if (indCount > rangeStart)
+        flush(indCount);
+    return true;
+}
+
+void Mesh::PackVertices(const Vertex* verts, size_t vertCount, std::vector<PackedVertex>& out,
+    glm::vec3& offset, glm::vec3& scale)
+{
+    out.resize(vertCount);
+    if (vertCount == 0)
+        return;
+
+    glm::vec3 lo = verts[0].Position;
+    glm::vec3 hi = verts[0].Position;
+    for (size_t i = 1; i < vertCount; i++)
+    {
+        lo = glm::min(lo, verts[i].Position);
+        hi = glm::max(hi, verts[i].Position);
+    }
+
+    offset = lo;
+    scale = glm::max(hi - lo, glm::vec3(1e-8f));
+    glm::vec3 invScale = 1.0f / scale;
+
+    for (size_t i = 0; i < vertCount; i++)
+    {
+        const Vertex& v = verts[i];
+        PackedVertex& p = out[i];
+
+        glm::vec3 q = glm::clamp((v.Position - offset) * invScale, 0.0f, 1.0f) * 65535.0f + 0.5f;
+        p.Position[0] = (uint16_t)q.x;
+        p.Position[1] = (uint16_t)q.y;
+        p.Position[2] = (uint16_t)q.z;
+        p.pad = 0;
+
+        p.Normal = glm::packSnorm2x16(octEncode(v.Normal));
+        p.TexCoords = glm::packHalf2x16(v.TexCoords);
+    }
+}
+
+void Mesh::BindMaterial(Shader& shader) const
+{
+    // Unit 0 holds the environment map
+    unsigned int unit = 1;
+
+    shader.setBool("packedVertices", format == VertexFormat::Packed);
+    if (format == VertexFormat::Packed)
+    {
+        shader.setVec3("posOffset", posOffset);
+        shader.setVec3("posScale", posScale);
+    }
 
     for (auto& t : textures)
     {
-        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, t.id);
+        GLState::BindTexture(unit, GL_TEXTURE_2D, t.texture ? t.texture->id.get() : 0);
         shader.setInt(t.type.c_str(), unit);
         unit++;
     }
+}
+
+void Mesh::drawSpan(size_t lod, unsigned int first, unsigned int count, GLsizei instanceCount) const
+{
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    unsigned int end = first + count;
+    for (unsigned int i = lodRangeStart[lod]; i < lodRangeStart[lod + 1]; i++)
+    {
+        const IndexRange& r = ranges[i];
+        unsigned int lo = std::max(first, r.first);
+        unsigned int hi = std::min(end, r.first + r.count);
+        if (lo >= hi)
+            continue;
+
+        // Pooled meshes are offset by their allocation, both are 0 otherwise
+        const GeometryPool::Allocation& a = pooled.Get();
+        void* offset = (void*)(a.indexOffset + lo * indexSize);
+        GLint baseVertex = (GLint)a.firstVertex + r.baseVertex;
+        if (instanceCount != 1)
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, hi - lo, indexType, offset, instanceCount, baseVertex);
+        else if (baseVertex == 0)
+            glDrawElements(GL_TRIANGLES, hi - lo, indexType, offset);
+        else
+            glDrawElementsBaseVertex(GL_TRIANGLES, hi - lo, indexType, offset, baseVertex);
+        counters.drawCalls++;
+    }
+}
+
+void Mesh::Draw(Shader& shader, size_t lod) const
+{
+    lod = std::min(lod, lods.size() - 1);
+    BindMaterial(shader);
+    bindVertexArray();
+    drawSpan(lod, lods[lod].firstIndex, lods[lod].indexCount);
+}
+
+void Mesh::DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t lod) const
+{
+    if (instances.Count() == 0)
+        return;
+
+    lod = std::min(lod, lods.size() - 1);
+    BindMaterial(shader);
+    bindVertexArray();
+    // Pool VAOs are shared with DrawBatch, which points the same attributes at its records
+    glBindBuffer(GL_ARRAY_BUFFER, instances.ID());
+    InstanceBuffer::SetAttributes();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    drawSpan(lod, lods[lod].firstIndex, lods[lod].indexCount, (GLsizei)instances.Count());
+}
+
+size_t Mesh::DrawCulled(Shader& shader, const glm::mat4& clipFromObject, const glm::vec3& eyeObject) const
+{
+    if (meshlets.empty())
+    {
+        Draw(shader, 0);
+        return lods[0].indexCount / 3;
+    }
+
+    // Reused between calls, drawing only ever happens on the GL thread
+    static std::vector<MeshletBuilder::Span> spans;
+    size_t triangles = MeshletBuilder::Cull(meshlets, MeshletBuilder::ObjectFrustum(clipFromObject, eyeObject), spans);
+    if (spans.empty())
+        return 0;
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    BindMaterial(shader);
+    bindVertexArray();
+    for (const MeshletBuilder::Span& s : spans)
+        drawSpan(0, s.firstIndex, s.indexCount);
+    return triangles;
 }
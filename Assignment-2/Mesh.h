@@ -1,11 +1,18 @@
 #ifndef MESH_CLASS_H
 #define MESH_CLASS_H
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "shaderClass.h"
+#include "GeometryPool.h"
+#include "GLHandle.h"
+#include "InstanceBuffer.h"
+
+class CachedTexture;
 
 struct Vertex {
     glm::vec3 Position;
@@ -13,28 +20,157 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// GPU-side vertex layouts
+enum class VertexFormat {
+    Float,  // Vertex as is, 32 bytes
+    Packed  // PackedVertex, 16 bytes
+};
+
+// 16-bit unorm position inside the mesh bounds, octahedral snorm16 normal, half float UV
+struct PackedVertex {
+    uint16_t Position[3];
+    uint16_t pad;
+    uint32_t Normal;    // packSnorm2x16 of the octahedral encoding
+    uint32_t TexCoords; // packHalf2x16
+};
+
+// Slice of the index buffer drawn with glDrawElementsBaseVertex
+struct IndexRange {
+    unsigned int first;  // first index in the EBO
+    unsigned int count;
+    int baseVertex;
+};
+
+// One level of detail: a slice of the mesh index list over the shared vertex buffer
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    float error;  // object-space simplification error versus LOD 0
+};
+
+// Cluster of up to 64 vertices / 124 consecutive triangles of LOD 0 (MeshletBuilder)
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int triangleCount;
+    unsigned int vertexCount;
+    unsigned int pad;
+    glm::vec3 center;     // bounding sphere
+    float radius;
+    glm::vec3 coneAxis;   // average face normal
+    float coneCutoff;     // sine of the cone spread, 1 disables backface rejection
+};
+
 struct TextureInfo {
-    unsigned int id;
+    std::shared_ptr<const CachedTexture> texture; // shared through TextureCache
     std::string type;   // baseColorMap / normalMap / metalRoughMap / emissiveMap
     std::string path;
 };
 
 class Mesh {
 public:
+    // CPU copies of the uploaded geometry, empty after ReleaseCpuData() or when built
+    // from caller owned memory
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<TextureInfo> textures;
 
-    unsigned int VAO, VBO, EBO;
+    // Own buffers, all empty for pooled meshes
+    VertexArrayHandle VAO;
+    BufferHandle VBO, EBO;
+    unsigned int indexCount = 0;
+    size_t gpuBytes = 0; // VBO + EBO
+
+    // Set when the buffers live in a shared GeometryPool, ranges are then offset by it
+    GeometryPool::Block pooled;
+
+    // GL_UNSIGNED_SHORT whenever every range spans at most 65536 vertices
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<IndexRange> ranges;
 
+    // LOD 0 is the full mesh, ranges of lod i are [lodRangeStart[i], lodRangeStart[i + 1])
+    std::vector<MeshLod> lods;
+    std::vector<unsigned int> lodRangeStart;
+
+    // Optional clusters of LOD 0 for CPU culling
+    std::vector<Meshlet> meshlets;
+
+    // Object-space AABB and bounding sphere
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    // Packed meshes dequantize with Position = posOffset + q * posScale in the vertex shader
+    VertexFormat format = VertexFormat::Float;
+    glm::vec3 posOffset = glm::vec3(0.0f);
+    glm::vec3 posScale = glm::vec3(1.0f);
+
+    // Submission counters, reset by whoever reports them
+    struct DrawCounters {
+        size_t drawCalls = 0;
+        size_t vertexArrayBinds = 0;
+    };
+    static DrawCounters counters;
+
+    // An empty lodTable means a single LOD covering all indices.
+    // With a pool the geometry is suballocated from it instead of getting its own buffers.
     Mesh(std::vector<Vertex> verts,
         std::vector<unsigned int> inds,
-        std::vector<TextureInfo> tex);
+        std::vector<TextureInfo> tex,
+        VertexFormat fmt = VertexFormat::Float,
+        std::vector<MeshLod> lodTable = {},
+        std::vector<Meshlet> clusters = {},
+        GeometryPool* pool = nullptr);
+
+    // Uploads straight from caller owned memory (e.g. a mapped MeshCache), keeps no CPU copy
+    Mesh(const Vertex* verts, size_t vertCount,
+        const unsigned int* inds, size_t indCount,
+        std::vector<TextureInfo> tex,
+        VertexFormat fmt = VertexFormat::Float,
+        std::vector<MeshLod> lodTable = {},
+        std::vector<Meshlet> clusters = {},
+        GeometryPool* pool = nullptr);
+
+    // Move-only, the GL objects and pool ranges are released with the last owner
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
+
+    // Frees vertices/indices once nothing on the CPU (picking, ray casts, cache writes) needs them
+    size_t ReleaseCpuData();
+
+    // Draws leave their VAO bound so consecutive meshes sharing it skip the rebind,
+    // call UnbindVertexArray() once the batch is done
+    void Draw(Shader& shader, size_t lod = 0) const;
+
+    // One instanced draw of lod per index range for every record in instances, the VAO is
+    // pointed at the buffer first. For the INSTANCED variant of vertex.glsl.
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, size_t lod = 0) const;
+
+    // Draws the meshlets of LOD 0 that pass frustum and cone culling, returns the triangles drawn
+    size_t DrawCulled(Shader& shader, const glm::mat4& clipFromObject, const glm::vec3& eyeObject) const;
+
+    // Splits a triangle list into ranges that each address at most 65536 vertices
+    // relative to their base vertex, writing 16-bit indices to dst. Ranges are appended
+    // to out with firstIndex added. Returns false if some triangle alone spans more.
+    static bool BuildShortRanges(const unsigned int* inds, size_t indCount,
+        unsigned short* dst, unsigned int firstIndex, std::vector<IndexRange>& out);
+
+    // Quantizes verts into out, returns the offset/scale the shader needs to decode positions
+    static void PackVertices(const Vertex* verts, size_t vertCount, std::vector<PackedVertex>& out,
+        glm::vec3& offset, glm::vec3& scale);
 
-    void Draw(Shader& shader); // no const now
+    // Attribute pointers 0-2 for the buffer bound to GL_ARRAY_BUFFER, into the bound VAO
+    static void SetVertexAttributes(VertexFormat fmt);
+    // Textures, packedVertices and the position decode uniforms of this mesh
+    void BindMaterial(Shader& shader) const;
+    static void UnbindVertexArray();
 
 private:
-    void setupMesh();
+    void bindVertexArray() const;
+    GLuint vertexArray() const { return pooled ? pooled.Pool()->VAO() : VAO.get(); }
+    // Draws indices [first, first + count) of lod, split at its 16-bit range boundaries
+    void drawSpan(size_t lod, unsigned int first, unsigned int count, GLsizei instanceCount = 1) const;
+    void setupMesh(const Vertex* verts, size_t vertCount, const unsigned int* inds, size_t indCount, GeometryPool* pool);
 };
 
 #endif
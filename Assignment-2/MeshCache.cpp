@@ -0,0 +1,462 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char Magic[4] = { 'M', 'S', 'H', 'C' };
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t importFlags;
+		uint32_t vertexStride;
+		uint64_t sourceHash;
+		uint32_t meshCount;
+		uint32_t processFlags;
+		uint64_t embeddedOffset;  // Blob table of embedded images
+		uint32_t embeddedCount;
+		uint32_t nodeCount;
+		uint64_t nodeOffset;      // Node table, parents before children
+	};
+
+	// 64-bit FNV-1a
+	uint64_t Fnv1a(const unsigned char* bytes, size_t count)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < count; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Vertex/index blocks start on 16 byte boundaries so the mapping can be handed to GL as-is
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + 15) & ~uint64_t(15);
+	}
+
+	void Pad(std::ofstream& out, uint64_t& cursor)
+	{
+		static const char zeros[16] = {};
+		uint64_t aligned = AlignUp(cursor);
+		out.write(zeros, aligned - cursor);
+		cursor = aligned;
+	}
+
+	void WriteString(std::ofstream& out, const std::string& s)
+	{
+		uint32_t len = (uint32_t)s.size();
+		out.write((const char*)&len, sizeof(len));
+		out.write(s.data(), len);
+	}
+}
+
+// -------------------- MappedFile --------------------
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(f);
+		return false;
+	}
+
+	HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m)
+	{
+		CloseHandle(f);
+		return false;
+	}
+
+	void* view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+
+	file = f;
+	mapping = m;
+	data = (const unsigned char*)view;
+	size = (size_t)fileSize.QuadPart;
+#else
+	int handle = open(path.c_str(), O_RDONLY);
+	if (handle < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(handle, &st) != 0 || st.st_size == 0)
+	{
+		close(handle);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+	if (view == MAP_FAILED)
+	{
+		close(handle);
+		return false;
+	}
+
+	fd = handle;
+	data = (const unsigned char*)view;
+	size = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (data) munmap((void*)data, size);
+	if (fd >= 0) close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+// -------------------- MeshCache --------------------
+std::string MeshCache::CachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+uint64_t MeshCache::HashFile(const std::string& path)
+{
+	MappedFile source;
+	if (!source.Open(path))
+		return 0;
+	return Fnv1a(source.Data(), source.Size());
+}
+
+uint64_t MeshCache::HashBytes(const unsigned char* bytes, size_t count)
+{
+	return Fnv1a(bytes, count);
+}
+
+bool MeshCache::Open(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags,
+	uint64_t sourceHash)
+{
+	entries.clear();
+	embedded.clear();
+	nodes.clear();
+	if (!file.Open(CachePath(sourcePath)))
+		return false;
+
+	Header header;
+	if (file.Size() < sizeof(Header))
+		return false;
+	std::memcpy(&header, file.Data(), sizeof(Header));
+
+	// Cheap checks first, the source hash touches every byte of the model
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+		header.version != Version ||
+		header.importFlags != importFlags ||
+		header.processFlags != processFlags ||
+		header.vertexStride != sizeof(Vertex))
+	{
+		file.Close();
+		return false;
+	}
+
+	uint64_t tableEnd = sizeof(Header) + (uint64_t)header.meshCount * sizeof(Entry);
+	uint64_t blobsEnd = header.embeddedOffset + (uint64_t)header.embeddedCount * sizeof(Blob);
+	uint64_t nodesEnd = header.nodeOffset + (uint64_t)header.nodeCount * sizeof(Node);
+	if (tableEnd > file.Size() || blobsEnd > file.Size() || nodesEnd > file.Size() ||
+		header.sourceHash != (sourceHash ? sourceHash : HashFile(sourcePath)))
+	{
+		file.Close();
+		return false;
+	}
+
+	entries.resize(header.meshCount);
+	std::memcpy(entries.data(), file.Data() + sizeof(Header), header.meshCount * sizeof(Entry));
+	embedded.resize(header.embeddedCount);
+	std::memcpy(embedded.data(), file.Data() + header.embeddedOffset, header.embeddedCount * sizeof(Blob));
+	nodes.resize(header.nodeCount);
+	std::memcpy(nodes.data(), file.Data() + header.nodeOffset, header.nodeCount * sizeof(Node));
+
+	for (const Blob& b : embedded)
+	{
+		if (b.offset + b.size > file.Size())
+		{
+			std::cout << "[MeshCache] truncated cache, ignoring: " << CachePath(sourcePath) << "\n";
+			entries.clear();
+			embedded.clear();
+			nodes.clear();
+			file.Close();
+			return false;
+		}
+	}
+
+	for (const Entry& e : entries)
+	{
+		if (e.vertexOffset + (uint64_t)e.vertexCount * sizeof(Vertex) > file.Size() ||
+			e.indexOffset + (uint64_t)e.indexCount * sizeof(unsigned int) > file.Size() ||
+			e.lodOffset + (uint64_t)e.lodCount * sizeof(MeshLod) > file.Size() ||
+			e.meshletOffset + (uint64_t)e.meshletCount * sizeof(Meshlet) > file.Size() ||
+			e.textureOffset > file.Size() ||
+			e.node >= nodes.size())
+		{
+			std::cout << "[MeshCache] truncated cache, ignoring: " << CachePath(sourcePath) << "\n";
+			entries.clear();
+			embedded.clear();
+			nodes.clear();
+			file.Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+const Vertex* MeshCache::Vertices(size_t mesh) const
+{
+	return (const Vertex*)(file.Data() + entries[mesh].vertexOffset);
+}
+
+const unsigned int* MeshCache::Indices(size_t mesh) const
+{
+	return (const unsigned int*)(file.Data() + entries[mesh].indexOffset);
+}
+
+size_t MeshCache::VertexCount(size_t mesh) const
+{
+	return entries[mesh].vertexCount;
+}
+
+size_t MeshCache::IndexCount(size_t mesh) const
+{
+	return entries[mesh].indexCount;
+}
+
+std::vector<MeshLod> MeshCache::Lods(size_t mesh) const
+{
+	std::vector<MeshLod> lods(entries[mesh].lodCount);
+	std::memcpy(lods.data(), file.Data() + entries[mesh].lodOffset, lods.size() * sizeof(MeshLod));
+	return lods;
+}
+
+std::vector<Meshlet> MeshCache::Meshlets(size_t mesh) const
+{
+	std::vector<Meshlet> meshlets(entries[mesh].meshletCount);
+	std::memcpy(meshlets.data(), file.Data() + entries[mesh].meshletOffset, meshlets.size() * sizeof(Meshlet));
+	return meshlets;
+}
+
+SceneGraph MeshCache::Nodes() const
+{
+	SceneGraph graph;
+	graph.Reserve(nodes.size());
+	for (const Node& n : nodes)
+		graph.AddNode(n.parent, glm::make_mat4(n.local));
+	return graph;
+}
+
+const unsigned char* MeshCache::EmbeddedData(size_t image) const
+{
+	return file.Data() + embedded[image].offset;
+}
+
+size_t MeshCache::EmbeddedSize(size_t image) const
+{
+	return (size_t)embedded[image].size;
+}
+
+std::vector<MeshCache::TextureRef> MeshCache::Textures(size_t mesh) const
+{
+	std::vector<TextureRef> textures;
+	const unsigned char* cursor = file.Data() + entries[mesh].textureOffset;
+	const unsigned char* end = file.Data() + file.Size();
+
+	auto readString = [&](std::string& s)
+		{
+			uint32_t len;
+			if (cursor + sizeof(len) > end) return false;
+			std::memcpy(&len, cursor, sizeof(len));
+			cursor += sizeof(len);
+			if (cursor + len > end) return false;
+			s.assign((const char*)cursor, len);
+			cursor += len;
+			return true;
+		};
+
+	for (uint32_t i = 0; i < entries[mesh].textureCount; i++)
+	{
+		TextureRef ref;
+		if (!readString(ref.type) || !readString(ref.path))
+			break;
+		textures.push_back(ref);
+	}
+	return textures;
+}
+
+bool MeshCache::Write(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags,
+	const std::vector<Mesh>& meshes, const SceneGraph& nodes, const std::vector<int>& meshNodes,
+	const std::vector<EmbeddedImage>& images, uint64_t sourceHash)
+{
+	Header header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.importFlags = importFlags;
+	header.processFlags = processFlags;
+	header.vertexStride = sizeof(Vertex);
+	header.sourceHash = sourceHash ? sourceHash : HashFile(sourcePath);
+	header.meshCount = (uint32_t)meshes.size();
+	header.embeddedCount = (uint32_t)images.size();
+	header.nodeCount = (uint32_t)nodes.Size();
+
+	// Lay out the data blocks behind the header and mesh table
+	std::vector<Entry> table(meshes.size());
+	uint64_t cursor = sizeof(Header) + meshes.size() * sizeof(Entry);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& m = meshes[i];
+		Entry& e = table[i];
+		e = {};
+		e.vertexCount = (uint32_t)m.vertices.size();
+		e.indexCount = (uint32_t)m.indices.size();
+		e.textureCount = (uint32_t)m.textures.size();
+		e.lodCount = (uint32_t)m.lods.size();
+		e.meshletCount = (uint32_t)m.meshlets.size();
+		e.node = (uint32_t)meshNodes[i];
+
+		cursor = AlignUp(cursor);
+		e.vertexOffset = cursor;
+		cursor += m.vertices.size() * sizeof(Vertex);
+
+		cursor = AlignUp(cursor);
+		e.indexOffset = cursor;
+		cursor += m.indices.size() * sizeof(unsigned int);
+
+		cursor = AlignUp(cursor);
+		e.lodOffset = cursor;
+		cursor += m.lods.size() * sizeof(MeshLod);
+
+		cursor = AlignUp(cursor);
+		e.meshletOffset = cursor;
+		cursor += m.meshlets.size() * sizeof(Meshlet);
+
+		e.textureOffset = cursor;
+		for (const TextureInfo& t : m.textures)
+			cursor += 2 * sizeof(uint32_t) + t.type.size() + t.path.size();
+	}
+
+	std::vector<Node> nodeTable(nodes.Size());
+	for (size_t i = 0; i < nodeTable.size(); i++)
+	{
+		nodeTable[i].parent = nodes.Parent((int)i);
+		std::memcpy(nodeTable[i].local, glm::value_ptr(nodes.Local((int)i)), sizeof(nodeTable[i].local));
+	}
+	cursor = AlignUp(cursor);
+	header.nodeOffset = cursor;
+	cursor += nodeTable.size() * sizeof(Node);
+
+	// Embedded images go last, behind their offset table
+	std::vector<Blob> blobs(images.size());
+	cursor = AlignUp(cursor);
+	header.embeddedOffset = cursor;
+	cursor += images.size() * sizeof(Blob);
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		blobs[i].offset = cursor;
+		blobs[i].size = images[i].size;
+		cursor += images[i].size;
+	}
+
+	// Write to a temp file first so a crash never leaves a half written cache behind
+	std::string finalPath = CachePath(sourcePath);
+	std::string tempPath = finalPath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)table.data(), table.size() * sizeof(Entry));
+
+		uint64_t written = sizeof(Header) + table.size() * sizeof(Entry);
+		for (const Mesh& m : meshes)
+		{
+			Pad(out, written);
+			out.write((const char*)m.vertices.data(), m.vertices.size() * sizeof(Vertex));
+			written += m.vertices.size() * sizeof(Vertex);
+
+			Pad(out, written);
+			out.write((const char*)m.indices.data(), m.indices.size() * sizeof(unsigned int));
+			written += m.indices.size() * sizeof(unsigned int);
+
+			Pad(out, written);
+			out.write((const char*)m.lods.data(), m.lods.size() * sizeof(MeshLod));
+			written += m.lods.size() * sizeof(MeshLod);
+
+			Pad(out, written);
+			out.write((const char*)m.meshlets.data(), m.meshlets.size() * sizeof(Meshlet));
+			written += m.meshlets.size() * sizeof(Meshlet);
+
+			for (const TextureInfo& t : m.textures)
+			{
+				WriteString(out, t.type);
+				WriteString(out, t.path);
+				written += 2 * sizeof(uint32_t) + t.type.size() + t.path.size();
+			}
+		}
+
+		Pad(out, written);
+		out.write((const char*)nodeTable.data(), nodeTable.size() * sizeof(Node));
+		written += nodeTable.size() * sizeof(Node);
+
+		Pad(out, written);
+		out.write((const char*)blobs.data(), blobs.size() * sizeof(Blob));
+		for (const EmbeddedImage& image : images)
+			out.write((const char*)image.data, image.size);
+
+		if (!out)
+		{
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(finalPath.c_str());
+	return std::rename(tempPath.c_str(), finalPath.c_str()) == 0;
+}
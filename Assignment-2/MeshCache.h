@@ -0,0 +1,128 @@
+#ifndef MESH_CACHE_CLASS_H
+#define MESH_CACHE_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "SceneGraph.h"
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+// Versioned binary cache of the final interleaved Vertex and index buffers built by Model.
+// The cache lives next to the source as "<source>.meshcache" and is keyed by a hash of the
+// source bytes, the Assimp import flags and Model's own processing options, so any change
+// to them forces a cold import.
+class MeshCache
+{
+public:
+	// Bump whenever the file layout or the Vertex struct changes
+	static constexpr uint32_t Version = 6;
+
+	struct TextureRef
+	{
+		std::string type;
+		std::string path;
+	};
+
+	// Maps the cache for sourcePath, returns false if it is missing or stale. sourceHash is
+	// HashFile(sourcePath) when the caller has it already, 0 hashes the source here.
+	bool Open(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags,
+		uint64_t sourceHash = 0);
+
+	size_t MeshCount() const { return entries.size(); }
+	// Pointers straight into the mapping, valid while this object is alive
+	const Vertex* Vertices(size_t mesh) const;
+	const unsigned int* Indices(size_t mesh) const;
+	size_t VertexCount(size_t mesh) const;
+	size_t IndexCount(size_t mesh) const;
+	std::vector<MeshLod> Lods(size_t mesh) const;
+	std::vector<Meshlet> Meshlets(size_t mesh) const;
+	std::vector<TextureRef> Textures(size_t mesh) const;
+	// Node the mesh hangs off in Nodes()
+	int MeshNode(size_t mesh) const { return (int)entries[mesh].node; }
+	// The source's node hierarchy with local transforms, not yet updated
+	SceneGraph Nodes() const;
+
+	// Compressed images that were embedded in the source (GLB "*N" textures), in source order
+	size_t EmbeddedCount() const { return embedded.size(); }
+	const unsigned char* EmbeddedData(size_t image) const;
+	size_t EmbeddedSize(size_t image) const;
+
+	struct EmbeddedImage
+	{
+		const unsigned char* data;
+		size_t size;
+	};
+
+	// Serialises the CPU side of meshes and the node each one is attached to,
+	// returns false on I/O failure. sourceHash as for Open.
+	static bool Write(const std::string& sourcePath, unsigned int importFlags, unsigned int processFlags,
+		const std::vector<Mesh>& meshes, const SceneGraph& nodes, const std::vector<int>& meshNodes,
+		const std::vector<EmbeddedImage>& images = {}, uint64_t sourceHash = 0);
+
+	static std::string CachePath(const std::string& sourcePath);
+	static uint64_t HashFile(const std::string& path);
+	static uint64_t HashBytes(const unsigned char* bytes, size_t count);
+
+private:
+	struct Entry
+	{
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t textureOffset;
+		uint64_t lodOffset;
+		uint64_t meshletOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t textureCount;
+		uint32_t lodCount;
+		uint32_t meshletCount;
+		uint32_t node;
+	};
+
+	struct Node
+	{
+		int32_t parent;
+		float local[16];
+	};
+
+	struct Blob
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	MappedFile file;
+	std::vector<Entry> entries;
+	std::vector<Blob> embedded;
+	std::vector<Node> nodes;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+MeshOptimizer::Report MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	Report report;
+	if (indices.size() < 3 || vertices.empty())
+		return report;
+
+	report.before = AnalyzeCache(indices, vertices.size());
+
+	std::vector<size_t> clusterStarts;
+	indices = Tipsify(indices, vertices.size(), CacheSize, clusterStarts);
+	OptimizeOverdraw(vertices, indices, clusterStarts);
+	OptimizeVertexFetch(vertices, indices);
+
+	report.after = AnalyzeCache(indices, vertices.size());
+	report.clusters = clusterStarts.size();
+	return report;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+	unsigned int cacheSize)
+{
+	CacheStats stats;
+	if (indices.size() < 3 || vertexCount == 0)
+		return stats;
+
+	// A vertex is resident while fewer than cacheSize misses happened since it was loaded
+	std::vector<size_t> loadedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t misses = 0;
+	size_t unique = 0;
+
+	for (unsigned int v : indices)
+	{
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			unique++;
+		}
+
+		if (loadedAt[v] == 0 || misses - loadedAt[v] >= cacheSize)
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = (float)misses / (float)unique;
+	return stats;
+}
+
+std::vector<unsigned int> MeshOptimizer::Tipsify(const std::vector<unsigned int>& indices, size_t vertexCount,
+	unsigned int cacheSize, std::vector<size_t>& clusterStarts)
+{
+	const size_t triCount = indices.size() / 3;
+	clusterStarts.clear();
+
+	// Vertex -> triangle adjacency in CSR form
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++)
+		live[indices[i]]++;
+
+	std::vector<size_t> adjOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjOffset[v + 1] = adjOffset[v] + live[v];
+
+	std::vector<unsigned int> adjacency(adjOffset[vertexCount]);
+	std::vector<size_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+	for (size_t t = 0; t < triCount; t++)
+		for (size_t k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triCount * 3);
+
+	size_t stamp = cacheSize + 1;
+	size_t cursor = 0;
+
+	// Next fanning vertex when the current one has nothing useful left in cache
+	auto skipDeadEnd = [&]() -> long long
+		{
+			while (!deadEnd.empty())
+			{
+				unsigned int d = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[d] > 0)
+					return d;
+			}
+			while (cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					return (long long)cursor++;
+				cursor++;
+			}
+			return -1;
+		};
+
+	long long fanning = skipDeadEnd();
+	bool newCluster = true;
+	while (fanning >= 0)
+	{
+		if (newCluster)
+		{
+			clusterStarts.push_back(output.size() / 3);
+			newCluster = false;
+		}
+
+		candidates.clear();
+		for (size_t a = adjOffset[fanning]; a < adjOffset[fanning + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (stamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = stamp++;
+			}
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that is still in cache and will stay there while its fan is emitted
+		long long next = -1;
+		long long best = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			long long priority = 0;
+			if (stamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = (long long)(stamp - cacheTime[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1)
+		{
+			// Cache locality is lost here, which is where the overdraw pass may reorder
+			next = skipDeadEnd();
+			newCluster = true;
+		}
+		fanning = next;
+	}
+
+	return output;
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const std::vector<size_t>& clusterStarts)
+{
+	const size_t triCount = indices.size() / 3;
+	const size_t clusterCount = clusterStarts.size();
+	if (clusterCount < 2)
+		return;
+
+	// Area weighted mesh centroid
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterArea(clusterCount, 0.0f);
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		size_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triCount;
+		for (size_t t = clusterStarts[c]; t < end; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+			float area = glm::length(cross);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterCentroid[c] += centroid * area;
+			clusterNormal[c] += cross;
+			clusterArea[c] += area;
+		}
+
+		meshCentroid += clusterCentroid[c];
+		meshArea += clusterArea[c];
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters that face away from the centre occlude the rest, so draw them first
+	std::vector<float> sortKey(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		if (clusterArea[c] <= 0.0f)
+			continue;
+		glm::vec3 centroid = clusterCentroid[c] / clusterArea[c];
+		float normalLength = glm::length(clusterNormal[c]);
+		if (normalLength > 0.0f)
+			sortKey[c] = glm::dot(centroid - meshCentroid, clusterNormal[c] / normalLength);
+	}
+
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (size_t c : order)
+	{
+		size_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triCount;
+		sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + end * 3);
+	}
+	indices.swap(sorted);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
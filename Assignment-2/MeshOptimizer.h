@@ -0,0 +1,51 @@
+#ifndef MESH_OPTIMIZER_CLASS_H
+#define MESH_OPTIMIZER_CLASS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+// Import-time index/vertex reordering for triangle lists.
+// Triangles are reordered with Tipsify (Sander et al. 2007) for the post-transform
+// vertex cache, the resulting clusters are sorted outside-in to cut overdraw,
+// and finally vertices are renumbered into first-use order for fetch locality.
+class MeshOptimizer
+{
+public:
+	// FIFO size assumed for both the optimization and the statistics
+	static constexpr unsigned int CacheSize = 16;
+
+	struct CacheStats
+	{
+		float acmr = 0.0f; // cache misses per triangle, 0.5 is the ideal for regular grids
+		float atvr = 0.0f; // cache misses per referenced vertex, 1.0 is the ideal
+	};
+
+	struct Report
+	{
+		CacheStats before;
+		CacheStats after;
+		size_t clusters = 0;
+	};
+
+	// Reorders indices and vertices in place, returns the before/after cache statistics
+	static Report Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	// Simulates a FIFO post-transform cache over a triangle list
+	static CacheStats AnalyzeCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+		unsigned int cacheSize = CacheSize);
+
+	// Tipsify triangle order, clusterStarts receives the first triangle of every cluster
+	static std::vector<unsigned int> Tipsify(const std::vector<unsigned int>& indices, size_t vertexCount,
+		unsigned int cacheSize, std::vector<size_t>& clusterStarts);
+
+	// Sorts clusters so outward facing ones are drawn first
+	static void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+		const std::vector<size_t>& clusterStarts);
+
+	// Renumbers vertices in first-use order, drops unreferenced ones
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+};
+
+#endif
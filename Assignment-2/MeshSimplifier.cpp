@@ -0,0 +1,237 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	// Symmetric 4x4 plane quadric plus the accumulated area weight
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+		double w = 0;
+
+		void addPlane(const glm::dvec3& n, double d, double weight)
+		{
+			a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+			b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+			c2 += weight * n.z * n.z; cd += weight * n.z * d;
+			d2 += weight * d * d;
+			w += weight;
+		}
+
+		void add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+			w += q.w;
+		}
+
+		// Mean squared distance of p to the accumulated planes
+		double error(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z
+				+ d2;
+			return w > 0 ? std::fabs(e) / w : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int from;
+		unsigned int to;
+	};
+
+	uint64_t edgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+	}
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices,
+	const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float& error)
+{
+	const size_t vertexCount = vertices.size();
+	std::vector<unsigned int> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	error = 0.0f;
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+		return result;
+
+	// Area weighted plane quadrics per vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t t = 0; t < result.size(); t += 3)
+	{
+		glm::dvec3 p0 = vertices[result[t + 0]].Position;
+		glm::dvec3 p1 = vertices[result[t + 1]].Position;
+		glm::dvec3 p2 = vertices[result[t + 2]].Position;
+		glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+		double len = glm::length(n);
+		if (len <= 0.0)
+			continue;
+		n /= len;
+		double d = -glm::dot(n, p0);
+		for (size_t k = 0; k < 3; k++)
+			quadrics[result[t + k]].addPlane(n, d, len * 0.5);
+	}
+
+	// Edges used by exactly one triangle are borders or UV/normal seams (split vertices),
+	// non-manifold edges are used by more than two. Their vertices never move.
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	for (size_t t = 0; t < result.size(); t += 3)
+		for (size_t k = 0; k < 3; k++)
+			edges.push_back(edgeKey(result[t + k], result[t + (k + 1) % 3]));
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<bool> locked(vertexCount, false);
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t j = i;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i != 2)
+		{
+			locked[(unsigned int)(edges[i] >> 32)] = true;
+			locked[(unsigned int)(edges[i] & 0xffffffffu)] = true;
+		}
+		i = j;
+	}
+
+	const double maxCost = (double)maxError * (double)maxError;
+	double worstCost = 0.0;
+
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<size_t> adjOffset(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triCount = result.size() / 3;
+
+		// Vertex -> triangle adjacency of the current index list
+		std::fill(adjOffset.begin(), adjOffset.end(), 0);
+		for (unsigned int v : result)
+			adjOffset[v + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjOffset[v + 1] += adjOffset[v];
+		adjacency.resize(result.size());
+		std::vector<size_t> fill(adjOffset.begin(), adjOffset.end() - 1);
+		for (size_t t = 0; t < triCount; t++)
+			for (size_t k = 0; k < 3; k++)
+				adjacency[fill[result[t * 3 + k]]++] = (unsigned int)t;
+
+		// Cheapest direction for every unique edge
+		edges.clear();
+		for (size_t t = 0; t < result.size(); t += 3)
+			for (size_t k = 0; k < 3; k++)
+				edges.push_back(edgeKey(result[t + k], result[t + (k + 1) % 3]));
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for (uint64_t e : edges)
+		{
+			unsigned int a = (unsigned int)(e >> 32);
+			unsigned int b = (unsigned int)(e & 0xffffffffu);
+			if (locked[a] && locked[b])
+				continue;
+
+			Quadric q = quadrics[a];
+			q.add(quadrics[b]);
+
+			double costAB = locked[a] ? HUGE_VAL : q.error(vertices[b].Position);
+			double costBA = locked[b] ? HUGE_VAL : q.error(vertices[a].Position);
+			if (costAB <= costBA)
+				collapses.push_back(Collapse{ costAB, a, b });
+			else
+				collapses.push_back(Collapse{ costBA, b, a });
+		}
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (unsigned int)v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Each collapse removes about two triangles, stop once the target is reachable
+		size_t budget = (triCount - targetIndexCount / 3) / 2 + 1;
+		size_t applied = 0;
+
+		for (const Collapse& c : collapses)
+		{
+			if (applied >= budget || c.cost > maxCost)
+				break;
+			if (touched[c.from] || remap[c.to] != c.to)
+				continue;
+
+			// Reject collapses that flip or degenerate any surviving triangle around from
+			const glm::vec3& target = vertices[c.to].Position;
+			bool valid = true;
+			for (size_t a = adjOffset[c.from]; a < adjOffset[c.from + 1] && valid; a++)
+			{
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+					continue;
+
+				glm::vec3 p[3], q[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					p[k] = vertices[tri[k]].Position;
+					q[k] = tri[k] == c.from ? target : p[k];
+				}
+				// Anything past ~75 degrees counts as a flip, small steps can add up over several passes
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+					valid = false;
+			}
+			if (!valid)
+				continue;
+
+			// Freeze the whole one-ring so later checks in this pass see up-to-date triangles
+			for (size_t a = adjOffset[c.from]; a < adjOffset[c.from + 1]; a++)
+			{
+				const unsigned int* tri = &result[adjacency[a] * 3];
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+			}
+
+			remap[c.from] = c.to;
+			quadrics[c.to].add(quadrics[c.from]);
+			worstCost = std::max(worstCost, c.cost);
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		// Rewrite the index list and drop triangles that collapsed
+		size_t write = 0;
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			unsigned int a = remap[result[t + 0]];
+			unsigned int b = remap[result[t + 1]];
+			unsigned int c = remap[result[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	error = (float)std::sqrt(worstCost);
+	return result;
+}
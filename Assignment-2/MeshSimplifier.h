@@ -0,0 +1,22 @@
+#ifndef MESH_SIMPLIFIER_CLASS_H
+#define MESH_SIMPLIFIER_CLASS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Mesh.h"
+
+// Quadric error metric (Garland & Heckbert) edge-collapse simplifier.
+// Vertices are never moved or created: every collapse snaps one endpoint onto the
+// other, so all levels of detail can share the vertex buffer of LOD 0.
+// Border edges and attribute seams are locked to keep the silhouette and UVs intact.
+class MeshSimplifier
+{
+public:
+	// Collapses edges until at most targetIndexCount indices remain, or no collapse
+	// below maxError is left. error receives the largest object-space distance error.
+	static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices,
+		const std::vector<unsigned int>& indices, size_t targetIndexCount, float maxError, float& error);
+};
+
+#endif
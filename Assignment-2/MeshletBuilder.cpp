@@ -0,0 +1,151 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	void computeBounds(const Vertex* verts, const unsigned int* inds, Meshlet& m)
+	{
+		const unsigned int* tri = inds + m.firstIndex;
+		const size_t count = (size_t)m.triangleCount * 3;
+
+		// Sphere around the AABB center, tight enough for clusters this small
+		glm::vec3 lo = verts[tri[0]].Position, hi = lo;
+		for (size_t i = 1; i < count; i++)
+		{
+			lo = glm::min(lo, verts[tri[i]].Position);
+			hi = glm::max(hi, verts[tri[i]].Position);
+		}
+		m.center = (lo + hi) * 0.5f;
+		float r2 = 0.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 d = verts[tri[i]].Position - m.center;
+			r2 = std::max(r2, glm::dot(d, d));
+		}
+		m.radius = std::sqrt(r2);
+
+		// Normal cone from the face normals
+		std::vector<glm::vec3> normals;
+		normals.reserve(m.triangleCount);
+		glm::vec3 axis(0.0f);
+		for (size_t t = 0; t < count; t += 3)
+		{
+			const glm::vec3& p0 = verts[tri[t + 0]].Position;
+			glm::vec3 n = glm::cross(verts[tri[t + 1]].Position - p0, verts[tri[t + 2]].Position - p0);
+			float len = glm::length(n);
+			if (len <= 0.0f)
+				continue;
+			normals.push_back(n / len);
+			axis += normals.back();
+		}
+
+		float axisLen = glm::length(axis);
+		m.coneAxis = axisLen > 0.0f ? axis / axisLen : glm::vec3(0.0f, 0.0f, 1.0f);
+
+		float minDot = axisLen > 0.0f ? 1.0f : -1.0f;
+		for (const glm::vec3& n : normals)
+			minDot = std::min(minDot, glm::dot(n, m.coneAxis));
+
+		// Store the sine of the spread, cones wider than ~85 degrees are never culled
+		m.coneCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> MeshletBuilder::Build(const Vertex* verts, const unsigned int* inds, size_t indCount,
+	unsigned int firstIndex)
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> unique;
+	unique.reserve(MaxVertices + 3);
+
+	Meshlet current = {};
+	auto flush = [&]()
+		{
+			if (current.triangleCount == 0)
+				return;
+			computeBounds(verts, inds, current);
+			current.firstIndex += firstIndex;
+			meshlets.push_back(current);
+		};
+
+	for (size_t t = 0; t + 2 < indCount; t += 3)
+	{
+		// Vertices of this triangle not yet in the current meshlet
+		unsigned int added = 0;
+		for (size_t k = 0; k < 3; k++)
+		{
+			unsigned int v = inds[t + k];
+			if (std::find(unique.begin(), unique.end(), v) == unique.end() &&
+				std::find(inds + t, inds + t + k, v) == inds + t + k)
+				added++;
+		}
+
+		if (current.triangleCount == MaxTriangles || unique.size() + added > MaxVertices)
+		{
+			flush();
+			current = {};
+			current.firstIndex = (unsigned int)t;
+			unique.clear();
+		}
+
+		for (size_t k = 0; k < 3; k++)
+			if (std::find(unique.begin(), unique.end(), inds[t + k]) == unique.end())
+				unique.push_back(inds[t + k]);
+		current.triangleCount++;
+		current.vertexCount = (unsigned int)unique.size();
+	}
+	flush();
+	return meshlets;
+}
+
+MeshletBuilder::Frustum MeshletBuilder::ObjectFrustum(const glm::mat4& clipFromObject, const glm::vec3& eyeObject)
+{
+	// Gribb/Hartmann plane extraction, glm matrices are column major
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(clipFromObject[0][i], clipFromObject[1][i], clipFromObject[2][i], clipFromObject[3][i]);
+
+	Frustum f;
+	f.planes[0] = row[3] + row[0];
+	f.planes[1] = row[3] - row[0];
+	f.planes[2] = row[3] + row[1];
+	f.planes[3] = row[3] - row[1];
+	f.planes[4] = row[3] + row[2];
+	f.planes[5] = row[3] - row[2];
+	for (glm::vec4& p : f.planes)
+		p /= glm::length(glm::vec3(p));
+	f.eye = eyeObject;
+	return f;
+}
+
+bool MeshletBuilder::Visible(const Meshlet& m, const Frustum& frustum)
+{
+	for (const glm::vec4& p : frustum.planes)
+		if (glm::dot(glm::vec3(p), m.center) + p.w < -m.radius)
+			return false;
+
+	// Backfacing if the eye lies inside the negated normal cone for every point of the sphere
+	glm::vec3 toCenter = m.center - frustum.eye;
+	return glm::dot(toCenter, m.coneAxis) < m.coneCutoff * glm::length(toCenter) + m.radius;
+}
+
+size_t MeshletBuilder::Cull(const std::vector<Meshlet>& meshlets, const Frustum& frustum, std::vector<Span>& spans)
+{
+	spans.clear();
+	size_t triangles = 0;
+	for (const Meshlet& m : meshlets)
+	{
+		if (!Visible(m, frustum))
+			continue;
+
+		triangles += m.triangleCount;
+		unsigned int count = m.triangleCount * 3;
+		if (!spans.empty() && spans.back().firstIndex + spans.back().indexCount == m.firstIndex)
+			spans.back().indexCount += count;
+		else
+			spans.push_back(Span{ m.firstIndex, count });
+	}
+	return triangles;
+}
@@ -1,73 +1,385 @@
 ﻿#include "Model.h"
+#include "Camera.h"
+#include "DrawBatch.h"
+#include "MeshCache.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
-#include "stb/stb_image.h"
+#include <limits>
+#include <glm/gtc/type_ptr.hpp>
 
-unsigned int TextureFromFile(const char* path)
+Model::Model(const char* path, unsigned int options, uint64_t sourceHash) : options(options), sourceHash(sourceHash) { loadModel(path); }
+
+
+void Model::Draw(Shader& shader) const
+{
+    drawnTriangles = 0;
+    culledTriangles = 0;
+    for (const auto& mesh : meshes)
+    {
+        mesh.Draw(shader);
+        drawnTriangles += mesh.lods[0].indexCount / 3;
+    }
+    Mesh::UnbindVertexArray();
+}
+
+void Model::DrawInstanced(Shader& shader, const InstanceBuffer& instances) const
+{
+    drawnTriangles = 0;
+    culledTriangles = 0;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        shader.setMat4("model", nodes.World(meshNodes[i]));
+        meshes[i].DrawInstanced(shader, instances);
+        drawnTriangles += meshes[i].lods[0].indexCount / 3 * instances.Count();
+    }
+    Mesh::UnbindVertexArray();
+}
+
+void Model::Submit(DrawBatch& batch, const glm::mat4& model) const
+{
+    for (size_t i = 0; i < meshes.size(); i++)
+        batch.Add(meshes[i], model * nodes.World(meshNodes[i]));
+}
+
+size_t Model::GpuBytes() const
 {
-    unsigned int id;
-    glGenTextures(1, &id);
+    size_t bytes = 0;
+    for (const auto& mesh : meshes)
+        bytes += mesh.gpuBytes;
+    return bytes;
+}
 
-    int w, h, ch;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &w, &h, &ch, STBI_rgb_alpha);
+void Model::Draw(Shader& shader, const Camera& camera, const glm::mat4& model) const
+{
+    // Pixels per world unit at distance 1
+    float pixelsPerUnit = camera.height / (2.0f * std::tan(camera.fovRadians * 0.5f));
 
-    if (!data) { std::cout << "FAILED TEX LOAD: " << path << "\n"; return 0; }
+    drawnTriangles = 0;
+    culledTriangles = 0;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const Mesh& mesh = meshes[i];
+        glm::mat4 world = model * nodes.World(meshNodes[i]);
+        shader.setMat4("model", world);
+        float scale = std::max(glm::length(glm::vec3(world[0])),
+            std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
 
-    glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+        glm::vec3 center = glm::vec3(world * glm::vec4(mesh.boundsCenter, 1.0f));
+        float distance = glm::length(center - camera.Position) - mesh.boundsRadius * scale;
+        distance = std::max(distance, camera.nearPlane);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        size_t lod = 0;
+        while (lod + 1 < mesh.lods.size() &&
+            mesh.lods[lod + 1].error * scale / distance * pixelsPerUnit <= lodPixelError)
+            lod++;
 
-    stbi_image_free(data);
-    return id;
+        size_t triangles = mesh.lods[lod].indexCount / 3;
+        if (lod == 0 && !mesh.meshlets.empty())
+        {
+            glm::mat4 clipFromObject = camera.cameraMatrix * world;
+            glm::vec3 eyeObject = glm::vec3(glm::inverse(world) * glm::vec4(camera.Position, 1.0f));
+            size_t drawn = mesh.DrawCulled(shader, clipFromObject, eyeObject);
+            culledTriangles += triangles - drawn;
+            triangles = drawn;
+        }
+        else
+        {
+            mesh.Draw(shader, lod);
+        }
+        drawnTriangles += triangles;
+    }
+    Mesh::UnbindVertexArray();
 }
 
-Model::Model(const char* path) { loadModel(path); }
+void Model::loadModel(const std::string& path)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    directory = path.substr(0, path.find_last_of("/\\"));
+    sourcePath = path;
+    if (sourceHash == 0)
+        sourceHash = MeshCache::HashFile(path);
 
-void Model::Draw(Shader& shader)
+    // Warm start: the mapped cache goes straight to glBufferData
+    if (loadFromCache(path))
+    {
+        std::cout << "[Model] " << path << ": warm load (cache) " << elapsedMs() << " ms\n";
+        return;
+    }
+
+    // Shared so embedded textures can decode straight out of the scene after we return
+    std::shared_ptr<Assimp::Importer> importer = std::make_shared<Assimp::Importer>();
+    const aiScene* scene = importer->ReadFile(path, ImportFlags);
+
+    if (!scene) { std::cout << "ASSIMP ERR " << importer->GetErrorString(); return; }
+
+    // Only compressed images (mHeight == 0) are supported, raw texels keep an empty slot
+    EmbeddedImages embedded;
+    embedded.owner = importer;
+    for (unsigned i = 0; i < scene->mNumTextures; i++)
+    {
+        const aiTexture* tex = scene->mTextures[i];
+        if (tex->mHeight == 0)
+            embedded.images.push_back({ (const unsigned char*)tex->pcData, tex->mWidth });
+        else
+            embedded.images.push_back({ nullptr, 0 });
+    }
+
+    std::vector<const aiMesh*> pending;
+    processNode(scene->mRootNode, SceneGraph::None, scene, pending);
+    nodes.Update();
+    processMeshes(pending, scene, embedded);
+    computeBounds();
+
+    double importMs = elapsedMs();
+    if (!MeshCache::Write(path, ImportFlags, options & CachedOptions, meshes, nodes, meshNodes, embedded.images, sourceHash))
+        std::cout << "[Model] could not write " << MeshCache::CachePath(path) << "\n";
+    std::cout << "[Model] " << path << ": cold load (Assimp) " << importMs
+        << " ms, cache write " << elapsedMs() - importMs << " ms\n";
+
+    // The cache write was the last reader of the CPU copies
+    if (!(options & KeepCpuData))
+    {
+        size_t released = 0;
+        for (Mesh& mesh : meshes)
+            released += mesh.ReleaseCpuData();
+        std::cout << "[Model]   released " << released << " bytes of CPU geometry\n";
+    }
+}
+
+bool Model::loadFromCache(const std::string& path)
 {
-    for (auto& mesh : meshes)
-        mesh.Draw(shader);
+    std::shared_ptr<MeshCache> mapped = std::make_shared<MeshCache>();
+    MeshCache& cache = *mapped;
+    if (!cache.Open(path, ImportFlags, options & CachedOptions, sourceHash))
+        return false;
+
+    // Embedded images are decoded from the mapping, which stays open until they are done
+    EmbeddedImages embedded;
+    embedded.owner = mapped;
+    for (size_t i = 0; i < cache.EmbeddedCount(); i++)
+        embedded.images.push_back({ cache.EmbeddedData(i), cache.EmbeddedSize(i) });
+
+    nodes = cache.Nodes();
+    nodes.Update();
+
+    meshes.reserve(cache.MeshCount());
+    for (size_t i = 0; i < cache.MeshCount(); i++)
+    {
+        meshNodes.push_back(cache.MeshNode(i));
+
+        std::vector<TextureInfo> textures;
+        for (const MeshCache::TextureRef& ref : cache.Textures(i))
+        {
+            TextureInfo tex;
+            tex.texture = acquireTexture(ref.path, ref.type, embedded);
+            tex.type = ref.type;
+            tex.path = ref.path;
+            textures.push_back(tex);
+        }
+
+        if (options & KeepCpuData)
+        {
+            // Copied out, the mapping only lives until the embedded textures are decoded
+            meshes.emplace_back(
+                std::vector<Vertex>(cache.Vertices(i), cache.Vertices(i) + cache.VertexCount(i)),
+                std::vector<unsigned int>(cache.Indices(i), cache.Indices(i) + cache.IndexCount(i)),
+                textures, vertexFormat(), cache.Lods(i), cache.Meshlets(i), geometryPool());
+        }
+        else
+        {
+            meshes.emplace_back(cache.Vertices(i), cache.VertexCount(i),
+                cache.Indices(i), cache.IndexCount(i), textures, vertexFormat(), cache.Lods(i), cache.Meshlets(i), geometryPool());
+        }
+    }
+    computeBounds();
+    return true;
 }
 
-void Model::loadModel(const std::string& path)
+void Model::computeBounds()
 {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_Triangulate |
-        aiProcess_GenNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices
-    );
+    if (meshes.empty())
+        return;
 
-    if (!scene) { std::cout << "ASSIMP ERR " << importer.GetErrorString(); return; }
+    // Box over the transformed mesh boxes, then a sphere around its center holding every mesh sphere
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const glm::mat4& node = nodes.World(meshNodes[i]);
+        glm::vec3 center = glm::vec3(node * glm::vec4((meshes[i].boundsMin + meshes[i].boundsMax) * 0.5f, 1.0f));
+        glm::vec3 half = (meshes[i].boundsMax - meshes[i].boundsMin) * 0.5f;
+        glm::vec3 extent(0.0f);
+        for (int column = 0; column < 3; column++)
+            extent += glm::abs(glm::vec3(node[column])) * half[column];
+        lo = glm::min(lo, center - extent);
+        hi = glm::max(hi, center + extent);
+    }
+    bounds.min = lo;
+    bounds.max = hi;
+    bounds.center = (lo + hi) * 0.5f;
 
-    directory = path.substr(0, path.find_last_of("/\\"));
-    processNode(scene->mRootNode, scene);
+    bounds.radius = 0.0f;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const glm::mat4& node = nodes.World(meshNodes[i]);
+        float scale = std::max(glm::length(glm::vec3(node[0])),
+            std::max(glm::length(glm::vec3(node[1])), glm::length(glm::vec3(node[2]))));
+        glm::vec3 center = glm::vec3(node * glm::vec4(meshes[i].boundsCenter, 1.0f));
+        bounds.radius = std::max(bounds.radius, glm::length(center - bounds.center) + meshes[i].boundsRadius * scale);
+    }
+}
+
+void Model::generateLods(MeshData& data)
+{
+    // Every level is simplified from LOD 0 so errors do not stack, and appended to the
+    // index list in its own vertex cache order. Vertices stay shared and untouched.
+    const std::vector<unsigned int> lod0 = data.indices;
+    size_t previous = lod0.size();
+
+    for (unsigned int level = 1; level < MaxLods; level++)
+    {
+        size_t target = (lod0.size() >> level) / 3 * 3;
+        if (target / 3 < MinLodTriangles)
+            break;
+
+        float error = 0.0f;
+        std::vector<unsigned int> lod = MeshSimplifier::Simplify(data.vertices, lod0, target, HUGE_VALF, error);
+
+        // Locked seams/borders can stall the simplifier, no point keeping a near copy
+        if (lod.size() > previous * 9 / 10)
+            break;
+        previous = lod.size();
+
+        std::vector<size_t> clusters;
+        lod = MeshOptimizer::Tipsify(lod, data.vertices.size(), MeshOptimizer::CacheSize, clusters);
+
+        data.lods.push_back(MeshLod{ (unsigned int)data.indices.size(), (unsigned int)lod.size(), error });
+        data.indices.insert(data.indices.end(), lod.begin(), lod.end());
+    }
+}
+
+VertexFormat Model::vertexFormat() const
+{
+    return (options & PackVertices) ? VertexFormat::Packed : VertexFormat::Float;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+GeometryPool* Model::geometryPool() const
 {
+    return (options & MergeGeometry) ? &GeometryPool::Shared(vertexFormat()) : nullptr;
+}
+
+void Model::processNode(const aiNode* node, int parent, const aiScene* scene, std::vector<const aiMesh*>& pending)
+{
+    // aiMatrix4x4 is row-major, glm is column-major
+    glm::mat4 local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    int index = nodes.AddNode(parent, local);
+
     for (unsigned i = 0; i < node->mNumMeshes; i++)
-        meshes.push_back(processMesh(scene->mMeshes[node->mMeshes[i]], scene));
+    {
+        pending.push_back(scene->mMeshes[node->mMeshes[i]]);
+        meshNodes.push_back(index);
+    }
 
+    // Depth-first, so every child lands behind its parent
     for (unsigned i = 0; i < node->mNumChildren; i++)
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], index, scene, pending);
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+std::shared_ptr<const CachedTexture> Model::acquireTexture(const std::string& path, const std::string& type, const EmbeddedImages& embedded) const
 {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned> indices;
-    std::vector<TextureInfo> textures; 
+    // Color maps are sRGB encoded, normals and metal/roughness are plain data
+    bool srgb = type == "baseColorMap" || type == "emissiveMap";
 
+    // "<source>*N" names the N-th image embedded in the source file
+    if (path.size() > sourcePath.size() + 1 && path.compare(0, sourcePath.size(), sourcePath) == 0 &&
+        path[sourcePath.size()] == '*')
+    {
+        size_t index = std::strtoul(path.c_str() + sourcePath.size() + 1, nullptr, 10);
+        if (index >= embedded.images.size() || !embedded.images[index].data)
+        {
+            std::cout << "[Model] unsupported embedded texture: " << path << "\n";
+            return TextureCache::Shared().Placeholder();
+        }
+        const MeshCache::EmbeddedImage& image = embedded.images[index];
+        return TextureCache::Shared().AcquireEmbedded(path, image.data, image.size, embedded.owner, srgb);
+    }
+    return TextureCache::Shared().Acquire(path, srgb);
+}
+
+void Model::processMeshes(const std::vector<const aiMesh*>& pending, const aiScene* scene, const EmbeddedImages& embedded)
+{
+    // CPU conversion of every aiMesh runs on the pool, each job owns one MeshData
+    std::vector<MeshData> converted(pending.size());
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool::Shared().ParallelFor(pending.size(), [&](size_t i)
+        {
+            auto meshStart = std::chrono::steady_clock::now();
+            processMesh(pending[i], scene, converted[i]);
+            converted[i].convertMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - meshStart).count();
+        });
+    double convertMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // GL uploads stay on the context thread, batched once conversion is done
+    double sumMs = 0.0;
+    meshes.reserve(meshes.size() + converted.size());
+    for (size_t i = 0; i < converted.size(); i++)
+    {
+        MeshData& data = converted[i];
+        for (TextureInfo& tex : data.textures)
+            tex.texture = acquireTexture(tex.path, tex.type, embedded);
+
+        std::cout << "[Model]   mesh " << i << ": " << data.vertices.size() << " verts, "
+            << data.indices.size() / 3 << " tris, " << data.convertMs << " ms";
+        if (options & OptimizeMeshes)
+        {
+            const MeshOptimizer::Report& r = data.optimizeReport;
+            std::cout << ", ACMR " << r.before.acmr << " -> " << r.after.acmr
+                << ", ATVR " << r.before.atvr << " -> " << r.after.atvr;
+        }
+        std::cout << "\n";
+        if (data.lods.size() > 1)
+        {
+            std::cout << "[Model]     LODs:";
+            for (const MeshLod& lod : data.lods)
+                std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+            std::cout << "\n";
+        }
+        if (!data.meshlets.empty())
+            std::cout << "[Model]     " << data.meshlets.size() << " meshlets\n";
+        sumMs += data.convertMs;
+
+        meshes.emplace_back(std::move(data.vertices), std::move(data.indices), std::move(data.textures),
+            vertexFormat(), std::move(data.lods), std::move(data.meshlets), geometryPool());
+    }
+
+    std::cout << "[Model]   converted " << converted.size() << " meshes on "
+        << ThreadPool::Shared().Size() << " threads in " << convertMs
+        << " ms (" << sumMs << " ms serial)\n";
+}
+
+void Model::processMesh(const aiMesh* mesh, const aiScene* scene, MeshData& out) const
+{
+    std::vector<Vertex>& vertices = out.vertices;
+    std::vector<unsigned>& indices = out.indices;
+    std::vector<TextureInfo>& textures = out.textures;
+
+    vertices.resize(mesh->mNumVertices);
+    const aiVector3D* uvs = mesh->mTextureCoords[0];
     for (unsigned i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex v;
+        Vertex& v = vertices[i];
         v.Position = { mesh->mVertices[i].x,mesh->mVertices[i].y,mesh->mVertices[i].z };
         v.Normal = glm::normalize(glm::vec3(
             mesh->mNormals[i].x,
@@ -75,38 +387,50 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
             mesh->mNormals[i].z
         ));
 
-        v.TexCoords = mesh->mTextureCoords[0] ?
-            glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y)
-            : glm::vec2(0);
-
-        vertices.push_back(v);
+        v.TexCoords = uvs ? glm::vec2(uvs[i].x, uvs[i].y) : glm::vec2(0);
     }
 
+    size_t indexCount = 0;
+    for (unsigned i = 0; i < mesh->mNumFaces; i++)
+        indexCount += mesh->mFaces[i].mNumIndices;
+
+    indices.resize(indexCount);
+    unsigned* dst = indices.data();
     for (unsigned i = 0; i < mesh->mNumFaces; i++)
         for (unsigned j = 0; j < mesh->mFaces[i].mNumIndices; j++)
-            indices.push_back(mesh->mFaces[i].mIndices[j]);
+            *dst++ = mesh->mFaces[i].mIndices[j];
+
+    if (options & OptimizeMeshes)
+        out.optimizeReport = MeshOptimizer::Optimize(vertices, indices);
+
+    out.lods.assign(1, MeshLod{ 0, (unsigned int)indices.size(), 0.0f });
+    if (options & GenerateLods)
+        generateLods(out);
+
+    if (options & BuildMeshlets)
+        out.meshlets = MeshletBuilder::Build(vertices.data(), indices.data(), out.lods[0].indexCount);
 
     if (mesh->mMaterialIndex >= 0)
     {
         aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
+        // Only records the paths, texture ids are resolved on the GL thread
         auto load = [&](aiTextureType type, std::string name)
             {
                 for (unsigned i = 0; i < mat->GetTextureCount(type); i++) {
                     aiString file; mat->GetTexture(type, i, &file);
-                    std::string full = directory + "/" + file.C_Str();
+                    // Embedded textures ("*0") are named after the source file, not the directory
+                    std::string full = file.data[0] == '*' ? sourcePath + file.C_Str() : directory + "/" + file.C_Str();
                     TextureInfo tex;
-                    tex.id = TextureFromFile(full.c_str());
                     tex.type = name;
                     tex.path = full;
                     textures.push_back(tex);
                 }
             };
 
+        // No shader samples the material maps yet, loading them would only cost decode time and VRAM
         //load(aiTextureType_DIFFUSE, "baseColorMap");
         //load(aiTextureType_NORMALS, "normalMap");
         //load(aiTextureType_METALNESS, "metalRoughMap");
         //load(aiTextureType_EMISSIVE, "emissiveMap");
     }
-
-    return Mesh(vertices, indices, textures);
 }
@@ -10,23 +10,113 @@
 #include <string>
 #include <vector>
 
+#include "FrustumCuller.h"
 #include "Mesh.h"         
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "SceneGraph.h"
 #include "Texture.h"
 #include "shaderClass.h"
 
+class Camera;
+class DrawBatch;
+
 class Model {
 public:
     std::vector<Mesh> meshes;
-    std::vector<TextureInfo> loadedTextures;
 
-    Model(const char* path);
-    void Draw(Shader& shader);
+    // Assimp post-processing used for every import, part of the MeshCache key
+    static constexpr unsigned int ImportFlags =
+        aiProcess_Triangulate |
+        aiProcess_GenNormals |
+        aiProcess_CalcTangentSpace |
+        aiProcess_JoinIdenticalVertices;
+
+    // Optional processing at import/upload time
+    enum LoadOptions : unsigned int {
+        OptimizeMeshes = 1u << 0, // vertex cache, overdraw and fetch order (MeshOptimizer)
+        PackVertices   = 1u << 1, // upload as 16-byte PackedVertex instead of 32-byte Vertex
+        GenerateLods   = 1u << 2, // simplified index lists sharing the LOD 0 vertices (MeshSimplifier)
+        BuildMeshlets  = 1u << 3, // LOD 0 clusters for CPU frustum/backface culling (MeshletBuilder)
+        MergeGeometry  = 1u << 4, // suballocate from the shared GeometryPool of the vertex layout
+        KeepCpuData    = 1u << 5, // keep Mesh::vertices/indices after upload (picking, ray casts)
+    };
+
+    // Options that change the cached buffers and therefore the MeshCache key
+    static constexpr unsigned int CachedOptions = OptimizeMeshes | GenerateLods | BuildMeshlets;
+
+    // LOD chain limits: every level halves the triangle count of the previous one
+    static constexpr unsigned int MaxLods = 5;
+    static constexpr size_t MinLodTriangles = 64;
+
+    // Coarsest LOD whose projected simplification error stays below this many pixels is drawn
+    float lodPixelError = 1.0f;
+    // Model-space bounds of every mesh under its node transform
+    Bounds bounds;
+    // Triangles submitted / rejected by meshlet culling in the last Draw call
+    mutable size_t drawnTriangles = 0;
+    mutable size_t culledTriangles = 0;
+
+    // sourceHash is MeshCache::HashFile(path) if the caller already has it, 0 hashes here
+    Model(const char* path, unsigned int options = OptimizeMeshes, uint64_t sourceHash = 0);
+
+    // Leaves the "model" uniform to the caller, node transforms are not applied
+    void Draw(Shader& shader) const;
+    // Sets "model" to placement * node transform for every mesh and picks a LOD from its
+    // screen-space error, meshes drawn at LOD 0 go through meshlet culling
+    void Draw(Shader& shader, const Camera& camera, const glm::mat4& model) const;
+
+    // One instanced draw per mesh for every record in instances, LOD 0, no culling. Sets
+    // "model" to the node transform, the INSTANCED vertex.glsl puts the instance matrix in front.
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances) const;
+
+    // Queues every mesh at placement * node transform into batch, LOD 0, no culling
+    void Submit(DrawBatch& batch, const glm::mat4& model) const;
+
+    // Vertex/index buffer memory of all meshes
+    size_t GpuBytes() const;
 
 private:
     std::string directory;
+    std::string sourcePath;
+    unsigned int options;
+    // Content hash of the source, computed once per load for both cache read and write
+    uint64_t sourceHash;
+
+    // Source node hierarchy (aiNode transforms), updated once after loading
+    SceneGraph nodes;
+    // Node of every entry in meshes
+    std::vector<int> meshNodes;
+
+    // Encoded images inside the model file (GLB "*N" textures), owner keeps the bytes
+    // alive until TextureStreamer has decoded them
+    struct EmbeddedImages {
+        std::vector<MeshCache::EmbeddedImage> images;
+        std::shared_ptr<const void> owner;
+    };
+
+    void computeBounds();
+    VertexFormat vertexFormat() const;
+    GeometryPool* geometryPool() const;
     void loadModel(const std::string& path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    bool loadFromCache(const std::string& path);
+
+    // CPU side of one imported mesh, filled on a worker thread before upload
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<TextureInfo> textures; // resolved through TextureCache on the GL thread
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        MeshOptimizer::Report optimizeReport;
+        double convertMs = 0.0;
+    };
+
+    void processNode(const aiNode* node, int parent, const aiScene* scene, std::vector<const aiMesh*>& pending);
+    void processMeshes(const std::vector<const aiMesh*>& pending, const aiScene* scene, const EmbeddedImages& embedded);
+    std::shared_ptr<const CachedTexture> acquireTexture(const std::string& path, const std::string& type, const EmbeddedImages& embedded) const;
+    void processMesh(const aiMesh* mesh, const aiScene* scene, MeshData& out) const;
+    static void generateLods(MeshData& data);
 };
 
 
@@ -0,0 +1,156 @@
+#include "OcclusionCuller.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// Unit cube around the origin, faces wound counter-clockwise from outside
+	const float CubeVertices[] = {
+		-1, -1, -1,   1, -1, -1,   1,  1, -1,  -1,  1, -1,
+		-1, -1,  1,   1, -1,  1,   1,  1,  1,  -1,  1,  1,
+	};
+	const GLubyte CubeIndices[] = {
+		4, 5, 6,  4, 6, 7,  // +z
+		1, 0, 3,  1, 3, 2,  // -z
+		5, 1, 2,  5, 2, 6,  // +x
+		0, 4, 7,  0, 7, 3,  // -x
+		7, 6, 2,  7, 2, 3,  // +y
+		0, 1, 5,  0, 5, 4,  // -y
+	};
+
+	// The near plane would clip the box of an object the camera is inside, its query would
+	// then come back empty. Such objects are drawn directly.
+	bool cameraInside(const Bounds& bounds, const glm::mat4& world, const glm::vec3& cameraPos, float margin)
+	{
+		glm::vec3 center = glm::vec3(world * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+		glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+		glm::vec3 extent = glm::abs(glm::vec3(world[0])) * half.x + glm::abs(glm::vec3(world[1])) * half.y +
+			glm::abs(glm::vec3(world[2])) * half.z + glm::vec3(margin);
+		glm::vec3 d = glm::abs(cameraPos - center);
+		return d.x <= extent.x && d.y <= extent.y && d.z <= extent.z;
+	}
+}
+
+OcclusionCuller::OcclusionCuller()
+	: boxShader("occlusion.vert", "occlusion.frag"),
+	cubeVAO(GenVertexArray()),
+	cubeVBO(GenBuffer()),
+	cubeEBO(GenBuffer())
+{
+	boxMatrix = boxShader.GetUniform<glm::mat4>("boxMatrix");
+
+	GLState::BindVertexArray(cubeVAO.get());
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CubeVertices), CubeVertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO.get());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(CubeIndices), CubeIndices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	GLState::BindVertexArray(0);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	for (Object& object : objects)
+		if (object.query)
+			glDeleteQueries(1, &object.query);
+	boxShader.Delete();
+}
+
+void OcclusionCuller::Draw(const std::vector<uint32_t>& candidates, const Bounds* bounds, const glm::mat4* worlds,
+	const glm::mat4& viewProjection, const glm::vec3& cameraPos, float nearPlane,
+	const std::function<void(uint32_t)>& draw)
+{
+	frame++;
+	stats = Stats();
+	tested.clear();
+
+	for (uint32_t i : candidates)
+	{
+		if (i >= objects.size())
+			objects.resize(i + 1);
+		Object& object = objects[i];
+		if (!object.query)
+			glGenQueries(1, &object.query);
+
+		// Left the frustum since its last query, the result says nothing about now
+		if (object.frame + 1 != frame)
+		{
+			object.visible = false;
+			object.pending = false;
+		}
+		object.frame = frame;
+		collect(object);
+
+		// The margin covers the near plane's corners, which sit a little further out than nearPlane
+		if (cameraInside(bounds[i], worlds[i], cameraPos, 2.0f * nearPlane))
+			object.visible = true;
+	}
+
+	// Phase 1: last frame's visible set, each draw queried for the next frame
+	for (uint32_t i : candidates)
+	{
+		Object& object = objects[i];
+		if (!object.visible)
+		{
+			tested.push_back(i);
+			continue;
+		}
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, object.query);
+		draw(i);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		object.pending = true;
+		stats.drawnFromLastFrame++;
+	}
+
+	if (tested.empty())
+		return;
+
+	// Phase 2: boxes of the rest against that depth, all queued before any result is needed
+	boxShader.Activate();
+	GLState::BindVertexArray(cubeVAO.get());
+	GLState::SetDepthMask(false);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (uint32_t i : tested)
+	{
+		const Bounds& b = bounds[i];
+		glm::mat4 box = glm::scale(glm::translate(worlds[i], (b.min + b.max) * 0.5f), (b.max - b.min) * 0.5f);
+		boxShader.set(boxMatrix, viewProjection * box);
+
+		Object& object = objects[i];
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, object.query);
+		glDrawElements(GL_TRIANGLES, (GLsizei)sizeof(CubeIndices), GL_UNSIGNED_BYTE, nullptr);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		object.pending = true;
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	GLState::SetDepthMask(true);
+	stats.boxesTested = tested.size();
+
+	// The GPU skips every draw whose box left no samples, the box query also decides the next frame
+	for (uint32_t i : tested)
+	{
+		glBeginConditionalRender(objects[i].query, GL_QUERY_WAIT);
+		draw(i);
+		glEndConditionalRender();
+	}
+}
+
+void OcclusionCuller::collect(Object& object)
+{
+	if (!object.pending)
+		return;
+
+	// Not back yet, keep the last answer rather than stall
+	GLuint available = 0;
+	glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	GLuint samples = 0;
+	glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &samples);
+	object.visible = samples != 0;
+	object.pending = false;
+	if (!object.visible)
+		stats.occluded++;
+}
@@ -0,0 +1,69 @@
+#ifndef OCCLUSION_CULLER_CLASS_H
+#define OCCLUSION_CULLER_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.h"
+#include "GLHandle.h"
+#include "shaderClass.h"
+
+// Two-phase GPU occlusion culling with GL_ANY_SAMPLES_PASSED queries and conditional rendering.
+// Phase 1 draws the objects that were visible last frame, which lays down most of the depth
+// buffer. Phase 2 rasterizes the object-space box of every other object with color and depth
+// writes off, then draws each one inside glBeginConditionalRender on its box query, so the GPU
+// drops the ones the depth buffer hides without the CPU ever waiting on a result. Every object
+// drawn carries a query too, the results are read a frame late and decide next frame's phases.
+class OcclusionCuller
+{
+public:
+	struct Stats
+	{
+		size_t drawnFromLastFrame = 0;  // phase 1
+		size_t boxesTested = 0;         // phase 2
+		size_t occluded = 0;            // results read this frame that came back without samples
+	};
+
+	// Builds the box program from occlusion.vert/.frag and the unit cube, needs a current context
+	OcclusionCuller();
+	~OcclusionCuller();
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	// Draws candidates (e.g. FrustumCuller::VisibleObjects) through draw(object). bounds and
+	// worlds are indexed by object, which must be stable across frames. draw has to activate its
+	// own program, the box pass leaves a different one bound.
+	void Draw(const std::vector<uint32_t>& candidates, const Bounds* bounds, const glm::mat4* worlds,
+		const glm::mat4& viewProjection, const glm::vec3& cameraPos, float nearPlane,
+		const std::function<void(uint32_t)>& draw);
+
+	const Stats& GetStats() const { return stats; }
+
+private:
+	struct Object
+	{
+		GLuint query = 0;
+		bool visible = false;  // assumed until a result says otherwise
+		bool pending = false;
+		uint32_t frame = 0;    // last frame it was a candidate
+	};
+
+	std::vector<Object> objects;
+	std::vector<uint32_t> tested;
+	uint32_t frame = 0;
+	Stats stats;
+
+	Shader boxShader;
+	Uniform<glm::mat4> boxMatrix;
+	VertexArrayHandle cubeVAO;
+	BufferHandle cubeVBO;
+	BufferHandle cubeEBO;
+
+	void collect(Object& object);
+};
+
+#endif
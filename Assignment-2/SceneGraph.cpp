@@ -0,0 +1,98 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE 1
+#endif
+
+namespace
+{
+	// out = a * b, column-major like glm. out must not alias a or b.
+	inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+	{
+#ifdef SCENE_GRAPH_SSE
+		const float* pa = glm::value_ptr(a);
+		const float* pb = glm::value_ptr(b);
+		float* po = glm::value_ptr(out);
+
+		__m128 a0 = _mm_loadu_ps(pa);
+		__m128 a1 = _mm_loadu_ps(pa + 4);
+		__m128 a2 = _mm_loadu_ps(pa + 8);
+		__m128 a3 = _mm_loadu_ps(pa + 12);
+		for (int c = 0; c < 4; c++)
+		{
+			const float* column = pb + c * 4;
+			__m128 r = _mm_mul_ps(a0, _mm_set1_ps(column[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(column[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(column[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(column[3])));
+			_mm_storeu_ps(po + c * 4, r);
+		}
+#else
+		out = a * b;
+#endif
+	}
+}
+
+int SceneGraph::AddNode(int parent, const glm::mat4& local)
+{
+	int node = (int)parents.size();
+	if (parent < None || parent >= node)
+	{
+		std::cout << "[SceneGraph] node " << node << " has invalid parent " << parent << ", added as a root\n";
+		parent = None;
+	}
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	firstDirty = std::min(firstDirty, (size_t)node);
+	return node;
+}
+
+void SceneGraph::Reserve(size_t count)
+{
+	parents.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirty.reserve(count);
+}
+
+void SceneGraph::SetLocal(int node, const glm::mat4& local)
+{
+	locals[node] = local;
+	dirty[node] = 1;
+	firstDirty = std::min(firstDirty, (size_t)node);
+}
+
+size_t SceneGraph::Update()
+{
+	const size_t count = parents.size();
+	size_t updated = 0;
+
+	// Parents come first, so a dirty flag reaches the whole subtree in the same pass
+	for (size_t i = firstDirty; i < count; i++)
+	{
+		int parent = parents[i];
+		if (parent != None)
+			dirty[i] |= dirty[parent];
+		if (!dirty[i])
+			continue;
+
+		if (parent == None)
+			worlds[i] = locals[i];
+		else
+			multiply(worlds[parent], locals[i], worlds[i]);
+		updated++;
+	}
+
+	if (firstDirty < count)
+		std::fill(dirty.begin() + firstDirty, dirty.end(), (unsigned char)0);
+	firstDirty = count;
+	return updated;
+}
@@ -0,0 +1,39 @@
+#ifndef SCENE_GRAPH_CLASS_H
+#define SCENE_GRAPH_CLASS_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Flat transform hierarchy. Nodes live in parallel arrays in topological order
+// (a parent always has a lower index than its children), so Update() refreshes
+// world matrices in one forward pass, starting at the first dirty node and skipping
+// every subtree whose local matrices did not change.
+class SceneGraph
+{
+public:
+	static constexpr int None = -1;
+
+	// parent must be None or an existing node, returns the new node's index
+	int AddNode(int parent, const glm::mat4& local = glm::mat4(1.0f));
+	void Reserve(size_t count);
+
+	void SetLocal(int node, const glm::mat4& local);
+	const glm::mat4& Local(int node) const { return locals[node]; }
+	// Valid for clean nodes, call Update() after SetLocal/AddNode
+	const glm::mat4& World(int node) const { return worlds[node]; }
+	int Parent(int node) const { return parents[node]; }
+	size_t Size() const { return parents.size(); }
+
+	// Recomputes dirty subtrees, returns how many world matrices were written
+	size_t Update();
+
+private:
+	std::vector<int> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;
+	size_t firstDirty = 0;
+};
+
+#endif
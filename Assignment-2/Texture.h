@@ -4,12 +4,14 @@
 #include <glad/glad.h>
 #include <string>
 
+#include "TextureStreamer.h"
+
 class Shader;
 
 class Texture
 {
 public:
-    GLuint ID;
+    StreamedTexture ID;
     GLenum type;
 
     Texture(const char* imageFile,
@@ -21,6 +23,7 @@ public:
     void texUnit(Shader& shader, const char* uniform, GLuint unit);
     void Bind()   const;
     void Unbind() const;
+    // Releases the texture early, otherwise the destructor does
     void Delete();
 };
 
@@ -0,0 +1,109 @@
+#include "TextureCache.h"
+
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+	// Decoded and uploaded in the background. Cooked: only the channels that carry data
+	// (R8 gray, RG8 gray + alpha, RGB8 opaque color, RGBA8), swizzled back to RGBA, with the
+	// prebuilt mip chain, color mips averaged in linear light when srgb. Otherwise RGBA8 with
+	// glGenerateMipmap.
+	TextureStreamer::Format streamFormat(bool cook, bool srgb)
+	{
+		TextureStreamer::Format format;
+		format.cook = cook;
+		format.srgb = srgb;
+		return format;
+	}
+
+	std::string resolvePath(const std::string& path)
+	{
+		std::error_code ec;
+		std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+		return ec ? path : canonical.generic_string();
+	}
+}
+
+TextureCache& TextureCache::Shared()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+std::shared_ptr<const CachedTexture> TextureCache::find(const std::string& key)
+{
+	auto it = textures.find(key);
+	if (it == textures.end())
+		return nullptr;
+
+	std::shared_ptr<const CachedTexture> texture = it->second.texture.lock();
+	if (texture)
+	{
+		hits++;
+		it->second.hits++;
+	}
+	return texture;
+}
+
+std::shared_ptr<const CachedTexture> TextureCache::Acquire(const std::string& path, bool srgb)
+{
+	std::string key = resolvePath(path);
+	if (std::shared_ptr<const CachedTexture> texture = find(key))
+		return texture;
+
+	misses++;
+	std::shared_ptr<CachedTexture> texture = std::make_shared<CachedTexture>();
+	texture->path = key;
+	texture->id = TextureStreamer::Shared().Load(path, streamFormat(cooking, srgb), &texture->bytes);
+
+	textures[key] = Entry{ texture, 0 };
+	return texture;
+}
+
+std::shared_ptr<const CachedTexture> TextureCache::AcquireEmbedded(const std::string& key,
+	const unsigned char* data, size_t size, std::shared_ptr<const void> owner, bool srgb)
+{
+	std::string resolved = resolvePath(key);
+	if (std::shared_ptr<const CachedTexture> texture = find(resolved))
+		return texture;
+
+	misses++;
+	std::shared_ptr<CachedTexture> texture = std::make_shared<CachedTexture>();
+	texture->path = resolved;
+	texture->id = TextureStreamer::Shared().LoadFromMemory(key, data, size, std::move(owner), streamFormat(cooking, srgb), &texture->bytes);
+
+	textures[resolved] = Entry{ texture, 0 };
+	return texture;
+}
+
+std::shared_ptr<const CachedTexture> TextureCache::Placeholder()
+{
+	if (std::shared_ptr<const CachedTexture> texture = placeholder.lock())
+		return texture;
+
+	std::shared_ptr<CachedTexture> texture = std::make_shared<CachedTexture>();
+	texture->id = TextureStreamer::Shared().Placeholder(streamFormat(false, false));
+	placeholder = texture;
+	return texture;
+}
+
+size_t TextureCache::LiveTextures() const
+{
+	size_t live = 0;
+	for (const auto& entry : textures)
+		if (!entry.second.texture.expired())
+			live++;
+	return live;
+}
+
+TextureCache::Stats TextureCache::GetStats() const
+{
+	Stats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	for (const auto& entry : textures)
+		if (std::shared_ptr<const CachedTexture> texture = entry.second.texture.lock())
+			stats.bytesSaved += entry.second.hits * texture->bytes;
+	return stats;
+}
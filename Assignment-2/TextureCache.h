@@ -0,0 +1,70 @@
+#ifndef TEXTURE_CACHE_CLASS_H
+#define TEXTURE_CACHE_CLASS_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <glad/glad.h>
+
+#include "TextureStreamer.h"
+
+// GL texture shared by every material slot that names the same image,
+// deleted when the last Mesh referencing it goes away
+class CachedTexture
+{
+public:
+	StreamedTexture id;  // holds a placeholder until TextureStreamer uploads the image
+	std::string path;
+	size_t bytes = 0;    // mip chain size, written by TextureStreamer on upload
+};
+
+// Process-wide cache of streamed 2D textures keyed by resolved path.
+// Only weak references are kept, so unused textures are freed with their Models
+// and reloaded on the next request. GL thread only.
+class TextureCache
+{
+public:
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t bytesSaved = 0;  // VRAM the hits would have allocated again, for live textures
+	};
+
+	// Never returns null, a texture that fails to decode keeps its placeholder.
+	// srgb marks color data so cooked mips are filtered in linear light.
+	std::shared_ptr<const CachedTexture> Acquire(const std::string& path, bool srgb = false);
+	// Image embedded in a model file, key names it (e.g. "Models/Bottle.glb*0").
+	// On a miss the encoded bytes are decoded in place while owner keeps them alive.
+	std::shared_ptr<const CachedTexture> AcquireEmbedded(const std::string& key,
+		const unsigned char* data, size_t size, std::shared_ptr<const void> owner, bool srgb = false);
+	// Shared 1x1 white texture for a material slot whose image can't be loaded at all
+	std::shared_ptr<const CachedTexture> Placeholder();
+
+	// Load through TextureCook (prebuilt mips, trimmed channels) instead of stb + glGenerateMipmap
+	void SetCooking(bool enabled) { cooking = enabled; }
+
+	// Sizes are recorded on upload, so bytesSaved is only final once the uploads are done
+	Stats GetStats() const;
+	size_t LiveTextures() const;
+
+	static TextureCache& Shared();
+
+private:
+	struct Entry
+	{
+		std::weak_ptr<const CachedTexture> texture;
+		size_t hits = 0;
+	};
+
+	std::unordered_map<std::string, Entry> textures;
+	std::weak_ptr<const CachedTexture> placeholder;
+	size_t hits = 0;
+	size_t misses = 0;
+	bool cooking = true;
+
+	std::shared_ptr<const CachedTexture> find(const std::string& key);
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "TextureCook.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TEXTURE_COOK_SSE 1
+#endif
+
+namespace
+{
+	const char Magic[4] = { 'T', 'X', 'C', 'K' };
+
+	enum Flags : uint32_t
+	{
+		FlagSrgb = 1u << 0,
+		FlagFlipped = 1u << 1,
+	};
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t width;
+		uint32_t height;
+		uint32_t channels;
+		uint32_t levelCount;
+		uint32_t flags;
+		uint32_t pad;
+	};
+
+	struct LevelEntry
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + 15) & ~uint64_t(15);
+	}
+
+	uint32_t flagsFor(bool srgb, bool flipped)
+	{
+		return (srgb ? FlagSrgb : 0u) | (flipped ? FlagFlipped : 0u);
+	}
+
+	// sRGB <-> linear through tables, the inverse is fine enough at 14 bits to round-trip every byte
+	const int LinearSteps = 16384;
+
+	struct SrgbTables
+	{
+		float toLinear[256];
+		unsigned char fromLinear[LinearSteps];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < LinearSteps; i++)
+			{
+				float l = i / float(LinearSteps - 1);
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = (unsigned char)(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	// 2x2 box filter over RGBA float pixels, edges clamp for odd sizes
+	void downsample(const float* src, int w, int h, float* dst, int dw, int dh)
+	{
+		for (int y = 0; y < dh; y++)
+		{
+			const float* row0 = src + (size_t)std::min(2 * y, h - 1) * w * 4;
+			const float* row1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * 4;
+			float* out = dst + (size_t)y * dw * 4;
+			for (int x = 0; x < dw; x++)
+			{
+				int x0 = std::min(2 * x, w - 1) * 4;
+				int x1 = std::min(2 * x + 1, w - 1) * 4;
+#ifdef TEXTURE_COOK_SSE
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+					_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+				_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+				for (int c = 0; c < 4; c++)
+					out[x * 4 + c] = 0.25f * (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+#endif
+			}
+		}
+	}
+
+	unsigned char encode(float v, bool srgb)
+	{
+		v = std::min(std::max(v, 0.0f), 1.0f);
+		if (srgb)
+			return srgbTables().fromLinear[(int)(v * (LinearSteps - 1) + 0.5f)];
+		return (unsigned char)(v * 255.0f + 0.5f);
+	}
+}
+
+std::string TextureCook::CookPath(const std::string& sourceName)
+{
+	std::string path = sourceName;
+	std::replace(path.begin(), path.end(), '*', '.');
+	return path + ".texcook";
+}
+
+bool TextureCook::Open(const std::string& cookPath, uint64_t sourceHash, bool srgb, bool flipped, Cooked& out)
+{
+	out.levels.clear();
+	if (!out.file.Open(cookPath))
+		return false;
+
+	Header header;
+	if (out.file.Size() < sizeof(Header))
+		return false;
+	std::memcpy(&header, out.file.Data(), sizeof(Header));
+
+	uint64_t tableEnd = sizeof(Header) + (uint64_t)header.levelCount * sizeof(LevelEntry);
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+		header.version != Version ||
+		header.sourceHash != sourceHash ||
+		header.flags != flagsFor(srgb, flipped) ||
+		header.channels < 1 || header.channels > 4 ||
+		header.levelCount == 0 ||
+		tableEnd > out.file.Size())
+	{
+		out.file.Close();
+		return false;
+	}
+
+	std::vector<LevelEntry> table(header.levelCount);
+	std::memcpy(table.data(), out.file.Data() + sizeof(Header), table.size() * sizeof(LevelEntry));
+	for (const LevelEntry& e : table)
+	{
+		// The uploader trusts these sizes, a level that disagrees with its dimensions or
+		// a level 0 that isn't the header's image would read past the mapping
+		bool sized = e.size == (uint64_t)e.width * e.height * header.channels;
+		bool inside = e.offset <= out.file.Size() && e.size <= out.file.Size() - e.offset;
+		bool base = !out.levels.empty() || (e.width == header.width && e.height == header.height);
+		if (!sized || !inside || !base)
+		{
+			out.levels.clear();
+			out.file.Close();
+			return false;
+		}
+		out.levels.push_back(Level{ out.file.Data() + e.offset, (size_t)e.size, (int)e.width, (int)e.height });
+	}
+
+	out.width = (int)header.width;
+	out.height = (int)header.height;
+	out.channels = (int)header.channels;
+	return true;
+}
+
+void TextureCook::Build(const unsigned char* rgba, int width, int height, bool srgb, Cooked& out)
+{
+	const size_t pixels = (size_t)width * height;
+
+	// Keep only the channels that carry information
+	bool opaque = true, gray = true;
+	for (size_t i = 0; i < pixels && (opaque || gray); i++)
+	{
+		const unsigned char* p = rgba + i * 4;
+		opaque = opaque && p[3] == 255;
+		gray = gray && p[0] == p[1] && p[1] == p[2];
+	}
+	const int channels = gray ? (opaque ? 1 : 2) : (opaque ? 3 : 4);
+	// Source component for each stored channel
+	static const int layouts[5][4] = { {}, { 0 }, { 0, 3 }, { 0, 1, 2 }, { 0, 1, 2, 3 } };
+	const int* layout = layouts[channels];
+
+	// Level sizes up front so storage never reallocates under the Level pointers
+	std::vector<int> widths, heights;
+	size_t total = 0;
+	for (int w = width, h = height;; w = std::max(1, w / 2), h = std::max(1, h / 2))
+	{
+		widths.push_back(w);
+		heights.push_back(h);
+		total += (size_t)w * h * channels;
+		if (w == 1 && h == 1)
+			break;
+	}
+
+	out.width = width;
+	out.height = height;
+	out.channels = channels;
+	out.storage.resize(total);
+	out.levels.clear();
+
+	// Level 0 is a straight copy of the kept channels
+	unsigned char* dst = out.storage.data();
+	for (size_t i = 0; i < pixels; i++)
+		for (int c = 0; c < channels; c++)
+			dst[i * channels + c] = rgba[i * 4 + layout[c]];
+	out.levels.push_back(Level{ dst, pixels * channels, width, height });
+	dst += pixels * channels;
+
+	// Mips are averaged in linear light, alpha and non-color data as stored
+	const float* toLinear = srgbTables().toLinear;
+	std::vector<float> current(pixels * 4), next;
+	for (size_t i = 0; i < pixels; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			current[i * 4 + c] = srgb ? toLinear[rgba[i * 4 + c]] : rgba[i * 4 + c] / 255.0f;
+		current[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+	}
+
+	for (size_t level = 1; level < widths.size(); level++)
+	{
+		int w = widths[level], h = heights[level];
+		next.resize((size_t)w * h * 4);
+		downsample(current.data(), widths[level - 1], heights[level - 1], next.data(), w, h);
+
+		size_t count = (size_t)w * h;
+		for (size_t i = 0; i < count; i++)
+			for (int c = 0; c < channels; c++)
+				dst[i * channels + c] = encode(next[i * 4 + layout[c]], srgb && layout[c] != 3);
+		out.levels.push_back(Level{ dst, count * channels, w, h });
+		dst += count * channels;
+
+		current.swap(next);
+	}
+}
+
+bool TextureCook::Write(const std::string& cookPath, uint64_t sourceHash, bool srgb, bool flipped, const Cooked& cooked)
+{
+	Header header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.sourceHash = sourceHash;
+	header.width = (uint32_t)cooked.width;
+	header.height = (uint32_t)cooked.height;
+	header.channels = (uint32_t)cooked.channels;
+	header.levelCount = (uint32_t)cooked.levels.size();
+	header.flags = flagsFor(srgb, flipped);
+
+	std::vector<LevelEntry> table(cooked.levels.size());
+	uint64_t cursor = sizeof(Header) + table.size() * sizeof(LevelEntry);
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		cursor = AlignUp(cursor);
+		table[i] = LevelEntry{ cursor, cooked.levels[i].size, (uint32_t)cooked.levels[i].width, (uint32_t)cooked.levels[i].height };
+		cursor += cooked.levels[i].size;
+	}
+
+	std::string tempPath = cookPath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)table.data(), table.size() * sizeof(LevelEntry));
+
+		static const char zeros[16] = {};
+		uint64_t written = sizeof(Header) + table.size() * sizeof(LevelEntry);
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			out.write(zeros, table[i].offset - written);
+			out.write((const char*)cooked.levels[i].data, cooked.levels[i].size);
+			written = table[i].offset + cooked.levels[i].size;
+		}
+
+		if (!out)
+		{
+			out.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(cookPath.c_str());
+	return std::rename(tempPath.c_str(), cookPath.c_str()) == 0;
+}
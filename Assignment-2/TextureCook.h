@@ -0,0 +1,56 @@
+#ifndef TEXTURE_COOK_CLASS_H
+#define TEXTURE_COOK_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+
+// First-run texture cooking. A decoded RGBA8 image is trimmed to the channels it
+// actually uses and gets its whole mip chain built on the CPU (averaged in linear light
+// for sRGB color data). The result is stored next to the source as
+// "<source>.texcook", a small KTX2-like container with one 16 byte aligned block per
+// level, so later runs map the file and upload every level as-is: no decode and no
+// glGenerateMipmap.
+class TextureCook
+{
+public:
+	// Bump whenever the file layout or the filter changes
+	static constexpr uint32_t Version = 1;
+
+	struct Level
+	{
+		const unsigned char* data;
+		size_t size;
+		int width;
+		int height;
+	};
+
+	// A cooked image. Levels point into storage when built in memory,
+	// or into file when opened from disk.
+	struct Cooked
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;           // 1 gray, 2 gray + alpha, 3 RGB, 4 RGBA
+		std::vector<Level> levels;  // level 0 first
+		std::vector<unsigned char> storage;
+		MappedFile file;
+	};
+
+	// "Models/a.png" -> "Models/a.png.texcook", embedded "Models/b.glb*0" -> "Models/b.glb.0.texcook"
+	static std::string CookPath(const std::string& sourceName);
+
+	// Maps a cook file, false if it is missing, stale or was cooked with other settings
+	static bool Open(const std::string& cookPath, uint64_t sourceHash, bool srgb, bool flipped, Cooked& out);
+
+	// Trims channels and builds the mip chain from tightly packed RGBA8 pixels
+	static void Build(const unsigned char* rgba, int width, int height, bool srgb, Cooked& out);
+
+	// Writes through a temp file, returns false on I/O failure
+	static bool Write(const std::string& cookPath, uint64_t sourceHash, bool srgb, bool flipped, const Cooked& cooked);
+};
+
+#endif
@@ -0,0 +1,426 @@
+#include "TextureStreamer.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "stb/stb_image.h"
+
+namespace
+{
+	GLenum channelFormat(int channels)
+	{
+		switch (channels)
+		{
+		case 1: return GL_RED;
+		case 2: return GL_RG;
+		case 3: return GL_RGB;
+		default: return GL_RGBA;
+		}
+	}
+
+	GLenum cookedInternalFormat(int channels)
+	{
+		switch (channels)
+		{
+		case 1: return GL_R8;
+		case 2: return GL_RG8;
+		case 3: return GL_RGB8;
+		default: return GL_RGBA8;
+		}
+	}
+
+	// Every level down to 1x1
+	size_t mipChainBytes(int width, int height, size_t texelBytes)
+	{
+		size_t bytes = 0;
+		for (;;)
+		{
+			bytes += (size_t)width * height * texelBytes;
+			if (width == 1 && height == 1)
+				return bytes;
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+	}
+}
+
+TextureStreamer& TextureStreamer::Shared()
+{
+	static TextureStreamer streamer;
+	return streamer;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Shared() and ThreadPool::Shared() are separate statics, so the pool may still be
+	// running decodes that push into decoded
+	std::unique_lock<std::mutex> lock(mutex);
+	closing = true;
+	jobsDone.wait(lock, [this]() { return inFlight == 0; });
+
+	// The GL context is gone by the time statics are destroyed, only CPU memory is released
+	for (Image& image : decoded)
+		stbi_image_free(image.pixels);
+}
+
+void ReleaseStreamedTexture(GLuint texture)
+{
+	TextureStreamer::Shared().Cancel(texture);
+	GLState::ForgetTexture(texture);
+	glDeleteTextures(1, &texture);
+}
+
+StreamedTexture TextureStreamer::Load(const std::string& path, const Format& format, size_t* residentBytes)
+{
+	Image image;
+	image.path = path;
+	image.format = format;
+	image.residentBytes = residentBytes;
+	return queue(std::move(image));
+}
+
+StreamedTexture TextureStreamer::LoadFromMemory(const std::string& name, const unsigned char* data, size_t size,
+	std::shared_ptr<const void> owner, const Format& format, size_t* residentBytes)
+{
+	Image image;
+	image.path = name;
+	image.format = format;
+	image.residentBytes = residentBytes;
+	image.source = data;
+	image.sourceSize = size;
+	image.sourceOwner = std::move(owner);
+	return queue(std::move(image));
+}
+
+StreamedTexture TextureStreamer::Placeholder(const Format& format)
+{
+	static const unsigned char placeholder[4] = { 255, 255, 255, 255 };
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState::BindTexture(format.target, texture);
+	glTexImage2D(format.target, 0, format.internalFormat, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+	// No mips yet, a mipmapped min filter would leave the placeholder incomplete
+	glTexParameteri(format.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(format.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(format.target, GL_TEXTURE_WRAP_S, format.wrap);
+	glTexParameteri(format.target, GL_TEXTURE_WRAP_T, format.wrap);
+	GLState::BindTexture(format.target, 0);
+	return StreamedTexture(texture);
+}
+
+StreamedTexture TextureStreamer::queue(Image image)
+{
+	StreamedTexture texture = Placeholder(image.format);
+	image.texture = texture.get();
+	{
+		// Shutting down, the texture keeps its placeholder
+		std::lock_guard<std::mutex> lock(mutex);
+		if (closing)
+			return texture;
+		inFlight++;
+	}
+	image.ticket = nextTicket++;
+	pending[texture.get()] = image.ticket;
+	stats.queued++;
+
+	ThreadPool::Shared().Submit([this, image = std::move(image)]() mutable
+		{
+			auto start = std::chrono::steady_clock::now();
+			const Format& f = image.format;
+			if (f.cook && !f.hdr)
+			{
+				cook(image);
+			}
+			else
+			{
+				int fileChannels = 0;
+				int len = (int)image.sourceSize;
+				stbi_set_flip_vertically_on_load_thread(f.flip);
+				if (image.source && f.hdr)
+					image.pixels = stbi_loadf_from_memory(image.source, len, &image.width, &image.height, &fileChannels, f.channels);
+				else if (image.source)
+					image.pixels = stbi_load_from_memory(image.source, len, &image.width, &image.height, &fileChannels, f.channels);
+				else if (f.hdr)
+					image.pixels = stbi_loadf(image.path.c_str(), &image.width, &image.height, &fileChannels, f.channels);
+				else
+					image.pixels = stbi_load(image.path.c_str(), &image.width, &image.height, &fileChannels, f.channels);
+
+				image.channels = f.channels ? f.channels : fileChannels;
+				image.bytes = (size_t)image.width * image.height * image.channels * (f.hdr ? sizeof(float) : 1);
+			}
+
+			// The encoded bytes are no longer needed
+			image.source = nullptr;
+			image.sourceOwner.reset();
+			image.workerMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			// Notified under the lock, the destructor can only go on once it is released
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(std::move(image));
+			if (--inFlight == 0)
+				jobsDone.notify_all();
+		});
+	return texture;
+}
+
+void TextureStreamer::cook(Image& image)
+{
+	const Format& f = image.format;
+	uint64_t hash = image.source ? MeshCache::HashBytes(image.source, image.sourceSize) : MeshCache::HashFile(image.path);
+	std::string cookPath = TextureCook::CookPath(image.path);
+
+	auto cooked = std::make_shared<TextureCook::Cooked>();
+	if (TextureCook::Open(cookPath, hash, f.srgb, f.flip, *cooked))
+	{
+		image.cookHit = true;
+	}
+	else
+	{
+		// First run: decode to RGBA8 once, the cook trims the channels afterwards
+		int width = 0, height = 0, fileChannels = 0;
+		stbi_set_flip_vertically_on_load_thread(f.flip);
+		unsigned char* rgba = image.source
+			? stbi_load_from_memory(image.source, (int)image.sourceSize, &width, &height, &fileChannels, STBI_rgb_alpha)
+			: stbi_load(image.path.c_str(), &width, &height, &fileChannels, STBI_rgb_alpha);
+		if (!rgba)
+			return;
+
+		TextureCook::Build(rgba, width, height, f.srgb, *cooked);
+		stbi_image_free(rgba);
+		image.cookWritten = TextureCook::Write(cookPath, hash, f.srgb, f.flip, *cooked);
+	}
+
+	image.width = cooked->width;
+	image.height = cooked->height;
+	image.channels = cooked->channels;
+	image.bytes = 0;
+	for (const TextureCook::Level& level : cooked->levels)
+		image.bytes += level.size;
+	image.cooked = std::move(cooked);
+}
+
+void TextureStreamer::Cancel(GLuint texture)
+{
+	pending.erase(texture);
+}
+
+bool TextureStreamer::Idle() const
+{
+	return pending.empty();
+}
+
+void TextureStreamer::Update(double budgetMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	pump(budgetMs, false);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.worstFrameMs = std::max(stats.worstFrameMs, ms);
+}
+
+void TextureStreamer::Finish()
+{
+	while (!Idle())
+	{
+		if (pump(HUGE_VAL, true) == 0)
+			std::this_thread::yield();
+	}
+}
+
+size_t TextureStreamer::pump(double budgetMs, bool wait)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t processed = 0;
+
+	for (;;)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty())
+				break;
+		}
+
+		Slot* slot;
+		if (!acquireSlot(slot, wait))
+			break;
+
+		Image image;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			image = std::move(decoded.front());
+			decoded.pop_front();
+		}
+		processed++;
+		stats.workerMs += image.workerMs;
+
+		// Deleted or reloaded while it was decoding
+		auto it = pending.find(image.texture);
+		if (it == pending.end() || it->second != image.ticket)
+		{
+			stbi_image_free(image.pixels);
+			continue;
+		}
+		pending.erase(it);
+
+		if (!image.pixels && !image.cooked)
+		{
+			std::cout << "FAILED TEX LOAD: " << image.path << "\n";
+			stats.failed++;
+			continue;
+		}
+
+		if (image.cooked)
+			uploadCooked(image, *slot);
+		else
+			upload(image, *slot);
+		stbi_image_free(image.pixels);
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (ms >= budgetMs)
+			break;
+	}
+	return processed;
+}
+
+bool TextureStreamer::acquireSlot(Slot*& slot, bool wait)
+{
+	Slot& s = ring[nextSlot];
+	if (s.fence)
+	{
+		GLenum status = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+			wait ? 1000000000ull : 0);
+		if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+			return false;
+		glDeleteSync(s.fence);
+		s.fence = nullptr;
+	}
+
+	slot = &s;
+	nextSlot = (nextSlot + 1) % RingSize;
+	return true;
+}
+
+void TextureStreamer::upload(Image& image, Slot& slot)
+{
+	if (!slot.pbo)
+		glGenBuffers(1, &slot.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+
+	if (image.bytes > slot.capacity)
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, image.bytes, nullptr, GL_STREAM_DRAW);
+		slot.capacity = image.bytes;
+	}
+
+	// The slot's fence has signalled, so nothing on the GPU still reads this buffer
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (dst)
+	{
+		std::memcpy(dst, image.pixels, image.bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, image.bytes, image.pixels);
+	}
+
+	const Format& f = image.format;
+	GLenum format = f.format ? f.format : channelFormat(image.channels);
+
+	GLState::BindTexture(f.target, image.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(f.target, 0, f.internalFormat, image.width, image.height, 0, format,
+		f.hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, (void*)0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (f.mipmaps)
+	{
+		glGenerateMipmap(f.target);
+		glTexParameteri(f.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	}
+	GLState::BindTexture(f.target, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stats.uploaded++;
+	stats.bytesUploaded += image.bytes;
+	if (image.residentBytes)
+	{
+		size_t texelBytes = (size_t)image.channels * (f.hdr ? sizeof(float) : 1);
+		*image.residentBytes = f.mipmaps ? mipChainBytes(image.width, image.height, texelBytes) : image.bytes;
+	}
+}
+
+void TextureStreamer::uploadCooked(Image& image, Slot& slot)
+{
+	if (!slot.pbo)
+		glGenBuffers(1, &slot.pbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+
+	if (image.bytes > slot.capacity)
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, image.bytes, nullptr, GL_STREAM_DRAW);
+		slot.capacity = image.bytes;
+	}
+
+	// Every level back to back, straight from the mapped cook file on a hit
+	const TextureCook::Cooked& cooked = *image.cooked;
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	size_t offset = 0;
+	for (const TextureCook::Level& level : cooked.levels)
+	{
+		if (dst)
+			std::memcpy((unsigned char*)dst + offset, level.data, level.size);
+		else
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, level.size, level.data);
+		offset += level.size;
+	}
+	if (dst)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	const Format& f = image.format;
+	GLenum internalFormat = cookedInternalFormat(cooked.channels);
+	GLenum format = channelFormat(cooked.channels);
+
+	GLState::BindTexture(f.target, image.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	offset = 0;
+	for (size_t i = 0; i < cooked.levels.size(); i++)
+	{
+		const TextureCook::Level& level = cooked.levels[i];
+		glTexImage2D(f.target, (GLint)i, internalFormat, level.width, level.height, 0, format,
+			GL_UNSIGNED_BYTE, (void*)offset);
+		offset += level.size;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Trimmed channels still read back as RGBA in the shaders
+	if (cooked.channels <= 2)
+	{
+		GLint alpha = cooked.channels == 2 ? GL_GREEN : GL_ONE;
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, alpha };
+		glTexParameteriv(f.target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+	glTexParameteri(f.target, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+	glTexParameteri(f.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	GLState::BindTexture(f.target, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stats.uploaded++;
+	stats.bytesUploaded += image.bytes;
+	if (image.residentBytes)
+		*image.residentBytes = image.bytes;
+	if (image.cookHit)
+		stats.cookHits++;
+	if (image.cookWritten)
+		stats.cooksWritten++;
+}
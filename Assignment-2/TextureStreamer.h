@@ -0,0 +1,140 @@
+#ifndef TEXTURE_STREAMER_CLASS_H
+#define TEXTURE_STREAMER_CLASS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <glad/glad.h>
+
+#include "GLHandle.h"
+#include "TextureCook.h"
+
+// Asynchronous image loading. Load() returns a texture name at once that holds a 1x1
+// placeholder, stb decodes on the shared ThreadPool, and Update() streams finished
+// images into their textures through a ring of pixel buffer objects guarded by fences,
+// spending at most a given number of milliseconds per frame. LDR images can go through
+// TextureCook instead, which uploads a prebuilt mip chain and skips the decode on later runs.
+// Everything except the decode itself runs on the GL thread.
+
+// Cancels a pending upload, then deletes the texture
+void ReleaseStreamedTexture(GLuint texture);
+using StreamedTexture = GLHandle<ReleaseStreamedTexture>;
+
+class TextureStreamer
+{
+public:
+	static constexpr int RingSize = 4;
+
+	// How the decoded image is stored
+	struct Format
+	{
+		GLenum target = GL_TEXTURE_2D;
+		GLenum internalFormat = GL_RGBA8;
+		GLenum format = 0;          // 0 picks GL_RED/GL_RG/GL_RGB/GL_RGBA from the channel count
+		int channels = 4;           // forced channel count, 0 keeps the file's
+		bool hdr = false;           // decode to float with stbi_loadf
+		bool flip = true;
+		bool mipmaps = true;
+		GLint wrap = GL_REPEAT;
+		bool cook = false;          // LDR only: load "<source>.texcook", cooking it on a miss
+		bool srgb = false;          // color data, cooked mips are averaged in linear light
+	};
+
+	struct Stats
+	{
+		size_t queued = 0;
+		size_t uploaded = 0;
+		size_t failed = 0;
+		size_t bytesUploaded = 0;
+		double worstFrameMs = 0.0;  // longest Update() so far
+		size_t cookHits = 0;        // uploaded straight from a cook file
+		size_t cooksWritten = 0;
+		double workerMs = 0.0;      // decode + cook time summed over the pool jobs
+	};
+
+	TextureStreamer() = default;
+	~TextureStreamer();
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Creates the texture with placeholder contents and queues the decode. residentBytes, if
+	// given, receives the size of the uploaded mip chain and must outlive the texture.
+	StreamedTexture Load(const std::string& path, const Format& format, size_t* residentBytes = nullptr);
+	// Same for an encoded image already in memory (PNG/JPEG/HDR bytes). The decoder reads
+	// data in place, owner keeps it alive until the decode job is done.
+	StreamedTexture LoadFromMemory(const std::string& name, const unsigned char* data, size_t size,
+		std::shared_ptr<const void> owner, const Format& format, size_t* residentBytes = nullptr);
+	// 1x1 white texture with nothing queued, what Load() hands out until the upload lands
+	StreamedTexture Placeholder(const Format& format);
+	// Drops a pending upload, StreamedTexture does this when it is destroyed
+	void Cancel(GLuint texture);
+
+	// Uploads decoded images until budgetMs is spent, at least one per call
+	void Update(double budgetMs);
+	// Blocks until every queued image is decoded and uploaded
+	void Finish();
+
+	bool Idle() const;
+	const Stats& GetStats() const { return stats; }
+
+	static TextureStreamer& Shared();
+
+private:
+	struct Image
+	{
+		GLuint texture = 0;
+		uint64_t ticket = 0;
+		std::string path;
+		Format format;
+		const unsigned char* source = nullptr;  // encoded bytes, or null to read path
+		size_t sourceSize = 0;
+		std::shared_ptr<const void> sourceOwner;
+		int width = 0, height = 0, channels = 0;
+		void* pixels = nullptr;     // owned by stb
+		std::shared_ptr<TextureCook::Cooked> cooked;  // replaces pixels for cooked images
+		size_t bytes = 0;
+		size_t* residentBytes = nullptr;  // GL thread only, written on upload
+		bool cookHit = false;
+		bool cookWritten = false;
+		double workerMs = 0.0;
+	};
+
+	struct Slot
+	{
+		GLuint pbo = 0;
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+	};
+
+	Slot ring[RingSize];
+	int nextSlot = 0;
+
+	// Written by the decode jobs. The destructor stops new submissions and waits until
+	// inFlight drops to 0, so no job outlives the object it writes into.
+	std::mutex mutex;
+	std::condition_variable jobsDone;
+	std::deque<Image> decoded;
+	size_t inFlight = 0;
+	bool closing = false;
+
+	// Texture -> ticket of the load it is waiting for, a stale ticket means it was cancelled
+	std::unordered_map<GLuint, uint64_t> pending;
+	uint64_t nextTicket = 1;
+	Stats stats;
+
+	StreamedTexture queue(Image image);
+	// Pool side of a cooked load, leaves image.cooked empty on failure
+	static void cook(Image& image);
+	// Uploads decoded images, returns how many were taken off the queue
+	size_t pump(double budgetMs, bool wait);
+	bool acquireSlot(Slot*& slot, bool wait);
+	void upload(Image& image, Slot& slot);
+	void uploadCooked(Image& image, Slot& slot);
+};
+
+#endif
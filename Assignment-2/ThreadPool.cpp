@@ -0,0 +1,91 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hw = std::thread::hardware_concurrency();
+		threadCount = hw > 1 ? hw - 1 : 1;
+	}
+
+	workers.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& t : workers)
+		t.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	// Workers pull indices from a shared counter so uneven items balance out.
+	// Completion is tracked per job, not per item, so no job can touch this
+	// stack frame after the wait below has returned.
+	std::atomic<size_t> next(0);
+	size_t jobsLeft = count < workers.size() ? count : workers.size();
+	std::mutex doneMutex;
+	std::condition_variable done;
+
+	size_t jobCount = jobsLeft;
+	for (size_t j = 0; j < jobCount; j++)
+	{
+		Submit([&]()
+			{
+				for (size_t i = next++; i < count; i = next++)
+					fn(i);
+
+				std::lock_guard<std::mutex> lock(doneMutex);
+				if (--jobsLeft == 0)
+					done.notify_one();
+			});
+	}
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	done.wait(lock, [&]() { return jobsLeft == 0; });
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_CLASS_H
+#define THREAD_POOL_CLASS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-only jobs. Jobs must never touch GL,
+// the context only lives on the main thread.
+class ThreadPool
+{
+public:
+	// 0 picks hardware_concurrency - 1 so the GL thread keeps a core
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queues a job, returns immediately
+	void Submit(std::function<void()> job);
+
+	// Runs fn(0..count-1) across the workers and blocks until all calls returned.
+	// Must not be called from inside a job.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+	size_t Size() const { return workers.size(); }
+
+	// Process-wide pool shared by the loaders
+	static ThreadPool& Shared();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop();
+};
+
+#endif
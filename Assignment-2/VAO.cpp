@@ -3,7 +3,7 @@
 // Constructor that generates a VAO ID
 VAO::VAO()
 {
-	glGenVertexArrays(1, &ID);
+	ID = GenVertexArray();
 }
 
 // Links a VBO to the VAO using a certain layout
@@ -18,17 +18,17 @@ void VAO::LinkAtrib(VBO& VBO, GLuint layout, GLuint numComponent, GLenum type, G
 // Binds the VAO
 void VAO::Bind()
 {
-	glBindVertexArray(ID);
+	GLState::BindVertexArray(ID.get());
 }
 
 // Unbinds the VAO
 void VAO::Unbind()
 {
-	glBindVertexArray(0);
+	GLState::BindVertexArray(0);
 }
 
 // Deletes the VAO
 void VAO::Delete()
 {
-	glDeleteVertexArrays(1, &ID);
+	ID.reset();
 }
\ No newline at end of file
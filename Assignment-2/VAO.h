@@ -2,13 +2,14 @@
 #define VAO_CLASS_H
 
 #include<glad/glad.h>
+#include"GLHandle.h"
 #include"VBO.h"
 
 class VAO
 {
 public:
-	// ID reference for the Vertex Array Object
-	GLuint ID;
+	// Owning reference for the Vertex Array Object, deleted with the VAO
+	VertexArrayHandle ID;
 	// Constructor that generates a VAO ID
 	VAO();
 
@@ -18,7 +19,7 @@ public:
 	void Bind();
 	// Unbinds the VAO
 	void Unbind();
-	// Deletes the VAO
+	// Deletes the VAO before the destructor would
 	void Delete();
 };
 #endif
@@ -3,15 +3,15 @@
 // Constructor that generates a Vertex Buffer Object and links it to vertices
 VBO::VBO(GLfloat* vertices, GLsizeiptr size)
 {
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	ID = GenBuffer();
+	glBindBuffer(GL_ARRAY_BUFFER, ID.get());
 	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
 // Binds the VBO
 void VBO::Bind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID.get());
 }
 
 // Unbinds the VBO
@@ -23,5 +23,5 @@ void VBO::Unbind()
 // Deletes the VBO
 void VBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	ID.reset();
 }
\ No newline at end of file
@@ -2,11 +2,13 @@
 #define VBO_CLASS_H
 
 #include<glad/glad.h>
+#include"GLHandle.h"
 
 class VBO
 {
 public:
-	GLuint ID;
+	// Deleted with the VBO, the object is move-only
+	BufferHandle ID;
 	VBO(GLfloat* vertices, GLsizeiptr size);
 
 	void Bind();
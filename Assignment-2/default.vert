@@ -10,10 +10,28 @@ out vec3 Normal;
 uniform mat4 camMatrix;
 uniform mat4 model;
 
+// Packed meshes (Mesh VertexFormat::Packed): unorm16 position inside the mesh
+// bounds and an octahedral normal in aNormal.xy
+uniform bool packedVertices;
+uniform vec3 posOffset;
+uniform vec3 posScale;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec3 pos = packedVertices ? posOffset + aPos * posScale : aPos;
+    vec3 nrm = packedVertices ? octDecode(aNormal.xy) : aNormal;
+
+    FragPos = vec3(model * vec4(pos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * nrm;
 
     gl_Position = camMatrix * vec4(FragPos, 1.0);
 }
@@ -7,6 +7,12 @@ in vec3 Normal;
 uniform sampler2D hdrMap;
 uniform vec3 cameraPos;
 
+#ifdef INSTANCED
+// Per-instance absorption tint, InstanceData::material indexes it
+flat in uint MaterialIndex;
+uniform vec3 instanceTints[4];
+#endif
+
 const float PI = 3.14159265359;
 
 // Direction → equirectangular UV
@@ -61,7 +67,11 @@ void main()
 
 
     // Subtle absorption tint
+#ifdef INSTANCED
+    glassColor *= instanceTints[MaterialIndex];
+#else
     glassColor *= vec3(0.95, 0.98, 1.0);
+#endif
 
     // ---------- Tone mapping (CRITICAL) ----------
     glassColor = glassColor / (glassColor + vec3(1.0));
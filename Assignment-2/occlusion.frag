@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+// Color writes are masked off, only the samples passed count
+void main()
+{
+    FragColor = vec4(1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// viewProjection * world * box placement
+uniform mat4 boxMatrix;
+
+void main()
+{
+    gl_Position = boxMatrix * vec4(aPos, 1.0);
+}
@@ -17,10 +17,25 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+// Variant defines have to follow #version, which must stay the first statement
+static void insert_defines(std::string& code, const char* defines)
+{
+	if (!defines || !*defines)
+		return;
+	size_t version = code.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : code.find('\n', version);
+	if (lineEnd == std::string::npos)
+		code.insert(0, defines);
+	else
+		code.insert(lineEnd + 1, defines);
+}
+
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const char* defines)
 {
 	std::string vertexCode = get_file_contents(vertexFile);
 	std::string fragmentCode = get_file_contents(fragmentFile);
+	insert_defines(vertexCode, defines);
+	insert_defines(fragmentCode, defines);
 
 	const char* vertexSource = vertexCode.c_str();
 	const char* fragmentSource = fragmentCode.c_str();
@@ -54,38 +69,128 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 
+	reflectUniforms();
+}
+
+void Shader::reflectUniforms()
+{
+	std::shared_ptr<UniformTable> table = std::make_shared<UniformTable>();
+	std::vector<GLint> locations;
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> buffer(maxLength + 1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+		std::string name(buffer.data(), length);
+
+		// Uniform block members have no location
+		GLint location = glGetUniformLocation(ID, name.c_str());
+		if (location < 0)
+			continue;
+
+		// Arrays come back as "name[0]", register the bare name and every element
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		{
+			std::string base = name.substr(0, name.size() - 3);
+			table->names.push_back(base);
+			locations.push_back(location);
+			for (GLint e = 0; e < size; e++)
+			{
+				std::string element = base + "[" + std::to_string(e) + "]";
+				table->names.push_back(element);
+				locations.push_back(glGetUniformLocation(ID, element.c_str()));
+			}
+		}
+		else
+		{
+			table->names.push_back(name);
+			locations.push_back(location);
+		}
+	}
+
+	// names is complete, so the views stay valid
+	for (size_t i = 0; i < table->names.size(); i++)
+		table->locations.emplace(table->names[i], locations[i]);
+	uniforms = std::move(table);
+}
+
+GLint Shader::Location(std::string_view name) const
+{
+	if (!uniforms)
+		return -1;
+	auto it = uniforms->locations.find(name);
+	return it == uniforms->locations.end() ? -1 : it->second;
 }
 
+void Shader::BindUniformBlock(const char* block, GLuint binding) const
+{
+	GLuint index = glGetUniformBlockIndex(ID, block);
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, index, binding);
+}
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setInt(std::string_view name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform1i(Location(name), value);
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+void Shader::setMat4(std::string_view name, const glm::mat4& mat) const {
+	glUniformMatrix4fv(Location(name), 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec3(std::string_view name, const glm::vec3& value) const {
+	glUniform3fv(Location(name), 1, &value[0]);
 }
 
-void Shader::setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+void Shader::setBool(std::string_view name, bool value) const {
+    glUniform1i(Location(name), (int)value);
+}
+
+void Shader::setFloat(std::string_view name, float value) const
+{
+	glUniform1f(Location(name), value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const
+{
+	glUniform1i(uniform.location, value);
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+	glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const
+{
+	glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+	glUniform3fv(uniform.location, 1, &value[0]);
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
 
 void Shader::Activate()
 {
-	glUseProgram(ID);
+	GLState::UseProgram(ID);
 }
 
 void Shader::Delete()
 {
+	GLState::ForgetProgram(ID);
 	glDeleteProgram(ID);
 }
\ No newline at end of file
@@ -2,20 +2,34 @@
 #define SHADER_CLASS_H
 
 #include <glad/glad.h>
+#include "GLState.h"
 #include <glm/glm.hpp>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Uniform location resolved once, for hot paths that set the same uniform every frame.
+// The type only picks the matching Shader::set overload, -1 is silently ignored by GL.
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+};
+
 class Shader
 {
 public:
     // Program ID
     GLuint ID;
 
-    // Constructor reads and builds the shader
-    Shader(const char* vertexFile, const char* fragmentFile);
+    // Constructor reads and builds the shader. defines (e.g. "#define INSTANCED\n") is
+    // inserted after the #version line of both stages to build a variant of the same files.
+    Shader(const char* vertexFile, const char* fragmentFile, const char* defines = nullptr);
 
     // Activate the shader
     void Activate();
@@ -23,13 +37,40 @@ public:
     // Delete the shader program
     void Delete();
 
-    // Uniform helper functions
-    void setInt(const std::string& name, int value) const;
-    void setBool(const std::string& name, bool value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
+    // Location of an active uniform from the table built at link time, -1 if there is none.
+    // No GL query and no allocation.
+    GLint Location(std::string_view name) const;
+
+    // Points a uniform block at a buffer binding, no-op if the program does not use the block
+    void BindUniformBlock(const char* block, GLuint binding) const;
+
+    template <typename T>
+    Uniform<T> GetUniform(std::string_view name) const { return Uniform<T>{ Location(name) }; }
+
+    // Uniform helper functions, by name (hash lookup) or pre-resolved handle
+    void setInt(std::string_view name, int value) const;
+    void setBool(std::string_view name, bool value) const;
+    void setFloat(std::string_view name, float value) const;
+    void setVec3(std::string_view name, const glm::vec3& value) const;
+    void setMat4(std::string_view name, const glm::mat4& mat) const;
+
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+
+private:
+    // Shared between copies of the Shader, the map keys point into names
+    struct UniformTable
+    {
+        std::vector<std::string> names;
+        std::unordered_map<std::string_view, GLint> locations;
+    };
+    std::shared_ptr<const UniformTable> uniforms;
 
+    // Reflects every active uniform (and each element of arrays) with glGetActiveUniform
+    void reflectUniforms();
 };
 
 
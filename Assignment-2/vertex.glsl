@@ -6,15 +6,65 @@ layout (location = 1) in vec3 aNormal;
 out vec3 WorldPos;
 out vec3 Normal;
 
-uniform mat4 model;
 uniform mat4 camMatrix;   // view * projection
 
+// Packed meshes (Mesh VertexFormat::Packed): unorm16 position inside the mesh
+// bounds and an octahedral normal in aNormal.xy
+uniform bool packedVertices;
+
+#ifdef DRAW_DATA
+// Per-draw record from DrawBatch, selected by the draw's baseInstance (or set as
+// constant attributes by the base-vertex fallback)
+layout (location = 3) in mat4 drawModel;
+layout (location = 7) in vec3 drawPosOffset;
+layout (location = 8) in vec3 drawPosScale;
+#else
+uniform mat4 model;       // node transform in the INSTANCED variant
+uniform vec3 posOffset;
+uniform vec3 posScale;
+#endif
+
+#ifdef INSTANCED
+// Per-instance data from InstanceBuffer, the matrix takes locations 3-6
+layout (location = 3) in mat4 aInstanceModel;
+layout (location = 7) in uint aInstanceMaterial;
+
+flat out uint MaterialIndex;
+#endif
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    vec4 world = model * vec4(aPos, 1.0);
+#ifdef DRAW_DATA
+    mat4 objectToWorld = drawModel;
+    vec3 offset = drawPosOffset;
+    vec3 scale = drawPosScale;
+#elif defined(INSTANCED)
+    mat4 objectToWorld = aInstanceModel * model;
+    vec3 offset = posOffset;
+    vec3 scale = posScale;
+    MaterialIndex = aInstanceMaterial;
+#else
+    mat4 objectToWorld = model;
+    vec3 offset = posOffset;
+    vec3 scale = posScale;
+#endif
+
+    vec3 pos = packedVertices ? offset + aPos * scale : aPos;
+    vec3 nrm = packedVertices ? octDecode(aNormal.xy) : aNormal;
+
+    vec4 world = objectToWorld * vec4(pos, 1.0);
     WorldPos = world.xyz;
 
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(transpose(inverse(objectToWorld))) * nrm;
 
     gl_Position = camMatrix * world;
 }